@@ -5,6 +5,9 @@
 #endif
 
 #include <sys/stat.h>				// for mkdir(), stat()
+#if !_WIN32
+#include <limits.h>					// for PATH_MAX
+#endif
 
 #if VSTUDIO_INTEGRATION
 #define WIN32_LEAN_AND_MEAN			// exclude rarely-used services from windown headers
@@ -50,6 +53,9 @@ void appPrintf(const char *fmt, ...)
 
 bool GIsSwError = false;			// software-gererated error
 
+THREAD_LOCAL char GErrorHistory[2048];
+static THREAD_LOCAL bool WasError = false;
+
 void appError(const char *fmt, ...)
 {
 	va_list	argptr;
@@ -63,6 +69,7 @@ void appError(const char *fmt, ...)
 
 #if DO_GUARD
 //	appNotify("ERROR: %s\n", buf);
+	WasError = false;
 	strcpy(GErrorHistory, buf);
 	appStrcatn(ARRAY_ARG(GErrorHistory), "\n");
 	THROW;
@@ -74,7 +81,7 @@ void appError(const char *fmt, ...)
 }
 
 
-static char NotifyBuf[512];
+static THREAD_LOCAL char NotifyBuf[512];
 
 void appSetNotifyHeader(const char *fmt, ...)
 {
@@ -129,9 +136,6 @@ void appNotify(const char *fmt, ...)
 }
 
 
-char GErrorHistory[2048];
-static bool WasError = false;
-
 static void LogHistory(const char *part)
 {
 	if (!GErrorHistory[0]) strcpy(GErrorHistory, "General Protection Fault !\n");
@@ -172,6 +176,21 @@ void appUnwindThrow(const char *fmt, ...)
 
 #endif // DO_GUARD
 
+void appRaiseErrorHistory(const char *history)
+{
+#if DO_GUARD
+	GIsSwError = true;
+	if (history != GErrorHistory)
+		appStrncpyz(GErrorHistory, history, ARRAY_COUNT(GErrorHistory));
+	// continue the chain with " <- " when history already has function names
+	int len = strlen(GErrorHistory);
+	WasError = (len > 0 && GErrorHistory[len-1] != '\n');
+	THROW;
+#else
+	appError("%s", history);
+#endif
+}
+
 
 /*-----------------------------------------------------------------------------
 	String functions
@@ -185,8 +204,9 @@ const char *va(const char *format, ...)
 {
 //	guardSlow(va);
 
-	static char buf[VA_BUFSIZE];
-	static int bufPos = 0;
+	// per-thread buffer, so va() could be used by worker threads
+	static THREAD_LOCAL char buf[VA_BUFSIZE];
+	static THREAD_LOCAL int bufPos = 0;
 	// wrap buffer
 	if (bufPos >= VA_BUFSIZE - VA_GOODSIZE) bufPos = 0;
 
@@ -313,6 +333,40 @@ const char *appStristr(const char *s1, const char *s2)
 	return s1 + (s - buf1);
 }
 
+#define FNV_OFFSET_BASIS		2166136261u
+#define FNV_PRIME				16777619u
+
+uint32 appStrhash(const char *str)
+{
+	uint32 hash = FNV_OFFSET_BASIS;
+	while (char c = *str++)
+		hash = (hash ^ (byte)c) * FNV_PRIME;
+	return hash;
+}
+
+uint32 appStrihash(const char *str)
+{
+	uint32 hash = FNV_OFFSET_BASIS;
+	while (char c = *str++)
+	{
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A'; // lowercase a character
+		hash = (hash ^ (byte)c) * FNV_PRIME;
+	}
+	return hash;
+}
+
+uint32 appStrihash(const char *str, int len)
+{
+	uint32 hash = FNV_OFFSET_BASIS;
+	for (int i = 0; i < len; i++)
+	{
+		char c = str[i];
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		hash = (hash ^ (byte)c) * FNV_PRIME;
+	}
+	return hash;
+}
+
 void appNormalizeFilename(char *filename)
 {
 	char *src = filename;
@@ -533,3 +587,33 @@ unsigned appGetFileType(const char *filename)
 		return FS_FILE;
 	return 0;						// just in case ... (may be, win32 have other file types?)
 }
+
+bool appGetFileSizeAndTime(const char *filename, int64 &Size, int64 &Time)
+{
+#if _WIN32
+	struct _stati64 buf;
+	if (_stati64(filename, &buf) == -1)
+		return false;
+#else
+	// note: using 'stat64' here because 'stat' ignores large files
+	struct stat64 buf;
+	if (stat64(filename, &buf) == -1)
+		return false;
+#endif
+	Size = buf.st_size;
+	Time = buf.st_mtime;
+	return true;
+}
+
+bool appGetFullPathName(const char *filename, char *dst, int dstSize)
+{
+#if _WIN32
+	if (!_fullpath(dst, filename, dstSize)) return false;
+#else
+	char FullPath[PATH_MAX];
+	if (!realpath(filename, FullPath)) return false;
+	appStrncpyz(dst, FullPath, dstSize);
+#endif
+	appNormalizeFilename(dst);
+	return true;
+}
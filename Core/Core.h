@@ -100,6 +100,7 @@
 #	define vsnwprintf			_vsnwprintf
 #	define FORCEINLINE			__forceinline
 #	define NORETURN				__declspec(noreturn)
+#	define THREAD_LOCAL			__declspec(thread)
 #	define stricmp				_stricmp
 #	define strnicmp				_strnicmp
 #	define GCC_PACK							// VC uses #pragma pack()
@@ -123,6 +124,9 @@
 #	define ROR16(val,shift)		_rotr16(val,shift)
 #	define ROL32(val,shift)		_rotl(val,shift)
 #	define ROR32(val,shift)		_rotr(val,shift)
+#	define BSWAP16(val)			_byteswap_ushort(val)
+#	define BSWAP32(val)			_byteswap_ulong(val)
+#	define BSWAP64(val)			_byteswap_uint64(val)
 
 #	define appDebugBreak		__debugbreak
 
@@ -134,6 +138,7 @@ typedef unsigned __int64		uint64;
 #	define vsnwprintf			swprintf
 #	define __FUNCSIG__			__PRETTY_FUNCTION__
 #	define NORETURN				__attribute__((noreturn))
+#	define THREAD_LOCAL			__thread
 #	if (__GNUC__ > 3) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 2))
 	// strange, but there is only way to work (inline+always_inline)
 #		define FORCEINLINE		inline __attribute__((always_inline))
@@ -143,6 +148,11 @@ typedef unsigned __int64		uint64;
 #	if (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 4))
 #		define IS_POD(T)		__is_pod(T)
 #	endif
+#	if (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 8))
+#		define BSWAP16(val)		__builtin_bswap16(val)
+#		define BSWAP32(val)		__builtin_bswap32(val)
+#		define BSWAP64(val)		__builtin_bswap64(val)
+#	endif
 #	define stricmp				strcasecmp
 #	define strnicmp				strncasecmp
 #	define GCC_PACK				__attribute__((__packed__))
@@ -203,6 +213,13 @@ typedef size_t					address_t;
 #define ROR32(val,shift)		( ((val) >> (shift)) | ((val) << (32-(shift))) )
 #endif
 
+// byte order reversal, 'val' should be unsigned
+#ifndef BSWAP16
+#define BSWAP16(val)			( (uint16) (((val) << 8) | ((val) >> 8)) )
+#define BSWAP32(val)			( ((val) << 24) | (((val) << 8) & 0xFF0000) | (((val) >> 8) & 0xFF00) | ((val) >> 24) )
+#define BSWAP64(val)			( ((uint64)BSWAP32((uint32)(val)) << 32) | BSWAP32((uint32)((val) >> 32)) )
+#endif
+
 
 #define COLOR_ESCAPE	'^'		// could be used for quick location of color-processing code
 
@@ -294,10 +311,16 @@ void appPrintf(const char *fmt, ...);
 extern bool GIsSwError;
 
 void appError(const char *fmt, ...);
+// Raise an error with error history captured in another thread
+void appRaiseErrorHistory(const char *history);
+
+// Error history is stored per thread
+extern THREAD_LOCAL char GErrorHistory[2048];
 
 
 // Log some information
 
+// Notify header is stored per thread
 void appSetNotifyHeader(const char *fmt, ...);
 void appNotify(const char *fmt, ...);
 
@@ -319,6 +342,11 @@ void appStrncpylwr(char *dst, const char *src, int count);
 void appStrcatn(char *dst, int count, const char *src);
 // Finds a substring s2 inside s1 with ignoring character case.
 const char *appStristr(const char *s1, const char *s2);
+// Case-sensitive FNV-1a hash of the string.
+uint32 appStrhash(const char *str);
+// Case-insensitive FNV-1a hash of the string, or of its first 'len' characters.
+uint32 appStrihash(const char *str);
+uint32 appStrihash(const char *str, int len);
 
 // Returns 'true' if name matches wildcard 'mask'.
 bool appMatchWildcard(const char *name, const char *mask, bool ignoreCase = false);
@@ -336,10 +364,16 @@ void appMakeDirectoryForFile(const char *filename);
 // and FS_DIR if this is a directory
 unsigned appGetFileType(const char *filename);
 
+// Get size and modification time of the file. Returns false if file doesn't exist.
+bool appGetFileSizeAndTime(const char *filename, int64 &Size, int64 &Time);
+// Convert file or directory name to normalized absolute path. Returns false if the name couldn't be resolved.
+bool appGetFullPathName(const char *filename, char *dst, int dstSize);
+
 
 // Memory management
 
-void* appMalloc(int size, int alignment = 8);
+// Allocated memory is zero-filled unless 'noInit' is set (used for buffers which are overwritten completely).
+void* appMalloc(int size, int alignment = 8, bool noInit = false);
 void* appRealloc(void *ptr, int newSize);
 void appFree(void *ptr);
 
@@ -498,8 +532,6 @@ long win32ExceptFilter(struct _EXCEPTION_POINTERS *info);
 void appUnwindPrefix(const char *fmt);		// not vararg (will display function name for unguardf only)
 NORETURN void appUnwindThrow(const char *fmt, ...);
 
-extern char GErrorHistory[2048];
-
 #else  // DO_GUARD
 
 #define guard(func)		{
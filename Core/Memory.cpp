@@ -1,4 +1,5 @@
 #include "Core.h"
+#include "Parallel.h"
 
 #if DEBUG_MEMORY
 #define MAX_STACK_TRACE			16
@@ -91,6 +92,7 @@ struct CBlockHeader
 
 #if DEBUG_MEMORY
 CBlockHeader* CBlockHeader::first = NULL;
+static CSpinLock DebugMemoryLock;		// protects allocation list and allocation points
 #endif
 
 
@@ -120,7 +122,7 @@ inline void OutOfMemory(int size)
 	appError("Out of memory: failed to allocate %d bytes", size);
 }
 
-void *appMalloc(int size, int alignment)
+void *appMalloc(int size, int alignment, bool noInit)
 {
 	guard(appMalloc);
 
@@ -138,7 +140,7 @@ void *appMalloc(int size, int alignment)
 		OutOfMemory(size);
 
 	void *ptr = Align(OffsetPointer(block, sizeof(CBlockHeader)), alignment);
-	if (size > 0)
+	if (size > 0 && !noInit)
 		memset(ptr, 0, size);
 	CBlockHeader *hdr = (CBlockHeader*)ptr - 1;
 	byte offset = (byte*)ptr - (byte*)block;
@@ -148,6 +150,7 @@ void *appMalloc(int size, int alignment)
 	hdr->blockSize = size;
 
 #if DEBUG_MEMORY
+	DebugMemoryLock.Lock();
 	hdr->Link();
 	// collect a stack trace
 	CStackTrace stack;
@@ -170,13 +173,14 @@ void *appMalloc(int size, int alignment)
 		*found = stack;
 	}
 	hdr->stack = found;
+	DebugMemoryLock.Unlock();
 #endif // DEBUG_MEMORY
 
 	// statistics
-	GTotalAllocationSize += size;
-	GTotalAllocationCount++;
+	appInterlockedAdd(&GTotalAllocationSize, size);
+	appInterlockedIncrement(&GTotalAllocationCount);
 #if PROFILE
-	GNumAllocs++;
+	appInterlockedIncrement(&GNumAllocs);
 #endif
 
 	return ptr;
@@ -198,7 +202,9 @@ void* appRealloc(void *ptr, int newSize)
 	assert(hdr->magic == BLOCK_MAGIC);
 	hdr->magic--;		// modify to any value
 #if DEBUG_MEMORY
+	DebugMemoryLock.Lock();
 	hdr->Unlink();
+	DebugMemoryLock.Unlock();
 #endif
 
 	int alignment = hdr->align + 1;
@@ -216,11 +222,11 @@ void* appRealloc(void *ptr, int newSize)
 
 	// statistics: we're allocating a new block with appMalloc, which counts statistics
 	// for this allocation, so only eliminate statistics from old memory block here
-	GTotalAllocationSize -= oldSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, -(size_t)oldSize);
+	appInterlockedAdd(&GTotalAllocationCount, -1);
 
 #if PROFILE
-	GNumAllocs++;
+	appInterlockedIncrement(&GNumAllocs);
 #endif
 
 	return newData;
@@ -240,13 +246,15 @@ void appFree(void *ptr)
 	assert(hdr->magic == BLOCK_MAGIC);
 	hdr->magic--;		// modify to any value
 #if DEBUG_MEMORY
+	DebugMemoryLock.Lock();
 	hdr->Unlink();
+	DebugMemoryLock.Unlock();
 	memset(ptr, FREE_BLOCK, hdr->blockSize);
 #endif
 
 	// statistics
-	GTotalAllocationSize -= hdr->blockSize;
-	GTotalAllocationCount--;
+	appInterlockedAdd(&GTotalAllocationSize, -(size_t)hdr->blockSize);
+	appInterlockedAdd(&GTotalAllocationCount, -1);
 
 	free(block);
 
@@ -0,0 +1,434 @@
+#include "Core.h"
+#include "Parallel.h"
+
+#if _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#	include <semaphore.h>
+#	include <sched.h>
+#	include <unistd.h>
+#	include <errno.h>
+#endif
+
+#define MAX_THREADS				64
+
+
+/*-----------------------------------------------------------------------------
+	Synchronization primitives
+-----------------------------------------------------------------------------*/
+
+void appYieldThread()
+{
+#if _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+CMutex::CMutex()
+{
+#if _WIN32
+	static_assert(sizeof(Handle) >= sizeof(CRITICAL_SECTION), "CMutex::Handle is too small");
+	InitializeCriticalSection((CRITICAL_SECTION*)Handle);
+#else
+	static_assert(sizeof(Handle) >= sizeof(pthread_mutex_t), "CMutex::Handle is too small");
+	// make it recursive, like CRITICAL_SECTION
+	pthread_mutexattr_t Attr;
+	pthread_mutexattr_init(&Attr);
+	pthread_mutexattr_settype(&Attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init((pthread_mutex_t*)Handle, &Attr);
+	pthread_mutexattr_destroy(&Attr);
+#endif
+}
+
+CMutex::~CMutex()
+{
+#if _WIN32
+	DeleteCriticalSection((CRITICAL_SECTION*)Handle);
+#else
+	pthread_mutex_destroy((pthread_mutex_t*)Handle);
+#endif
+}
+
+void CMutex::Lock()
+{
+#if _WIN32
+	EnterCriticalSection((CRITICAL_SECTION*)Handle);
+#else
+	pthread_mutex_lock((pthread_mutex_t*)Handle);
+#endif
+}
+
+void CMutex::Unlock()
+{
+#if _WIN32
+	LeaveCriticalSection((CRITICAL_SECTION*)Handle);
+#else
+	pthread_mutex_unlock((pthread_mutex_t*)Handle);
+#endif
+}
+
+
+struct CSemaphore
+{
+#if _WIN32
+	HANDLE		Handle;
+
+	CSemaphore()
+	{
+		Handle = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	}
+	~CSemaphore()
+	{
+		CloseHandle(Handle);
+	}
+	void Post()
+	{
+		ReleaseSemaphore(Handle, 1, NULL);
+	}
+	void Wait()
+	{
+		WaitForSingleObject(Handle, INFINITE);
+	}
+#else
+	sem_t		Handle;
+
+	CSemaphore()
+	{
+		sem_init(&Handle, 0, 0);
+	}
+	~CSemaphore()
+	{
+		sem_destroy(&Handle);
+	}
+	void Post()
+	{
+		sem_post(&Handle);
+	}
+	void Wait()
+	{
+		while (sem_wait(&Handle) != 0 && errno == EINTR)
+		{}
+	}
+#endif // _WIN32
+};
+
+
+/*-----------------------------------------------------------------------------
+	Job queue
+-----------------------------------------------------------------------------*/
+
+static int GNumThreads = 0;				// 0 = not initialized yet
+
+int appGetNumThreads()
+{
+	if (!GNumThreads)
+	{
+#if _WIN32
+		SYSTEM_INFO Info;
+		GetSystemInfo(&Info);
+		int NumCores = Info.dwNumberOfProcessors;
+#else
+		int NumCores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		GNumThreads = bound(NumCores, 1, MAX_THREADS);
+	}
+	return GNumThreads;
+}
+
+void appSetNumThreads(int Num)
+{
+	if (Num <= 0)
+	{
+		GNumThreads = 0;		// autodetect
+		Num = appGetNumThreads();
+	}
+	GNumThreads = min(Num, MAX_THREADS);
+}
+
+// Executes the function with catching errors; error message remains in GErrorHistory
+static bool CallWithErrorCatching(void (*Func)(int, void*), int Index, void* Param)
+{
+	TRY
+	{
+		Func(Index, Param);
+		return true;
+	}
+	CATCH
+	{
+		return false;
+	}
+}
+
+static void ExecuteJobFunc(int Index, void* Param)
+{
+	((CJob*)Param)->Execute();
+}
+
+struct CJobQueue
+{
+	CMutex		Lock;
+	CSemaphore	Signal;					// counts queued jobs, used to wake up worker threads
+	CJob*		Head;
+	CJob*		Tail;
+	int			NumWorkers;
+
+	CJobQueue()
+	:	Head(NULL)
+	,	Tail(NULL)
+	,	NumWorkers(-1)
+	{}
+
+	// Should be called with locked queue
+	void StartWorkers()
+	{
+		if (NumWorkers >= 0) return;
+		NumWorkers = appGetNumThreads() - 1;		// calling thread is also working
+		for (int i = 0; i < NumWorkers; i++)
+		{
+#if _WIN32
+			HANDLE Thread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+			if (!Thread) appError("Unable to create a thread");
+			CloseHandle(Thread);
+#else
+			pthread_t Thread;
+			if (pthread_create(&Thread, NULL, WorkerThread, this) != 0)
+				appError("Unable to create a thread");
+			pthread_detach(Thread);
+#endif
+		}
+	}
+
+	void Push(CJob* Job)
+	{
+		Job->Next = NULL;
+		if (Tail)
+			Tail->Next = Job;
+		else
+			Head = Job;
+		Tail = Job;
+	}
+
+	void Remove(CJob* Job)
+	{
+		CJob* Prev = NULL;
+		for (CJob* J = Head; J; Prev = J, J = J->Next)
+		{
+			if (J != Job) continue;
+			if (Prev)
+				Prev->Next = J->Next;
+			else
+				Head = J->Next;
+			if (Tail == J) Tail = Prev;
+			J->Next = NULL;
+			return;
+		}
+		appError("Job is not queued");
+	}
+
+	static void Execute(CJob* Job)
+	{
+		if (!CallWithErrorCatching(ExecuteJobFunc, 0, Job))
+		{
+			Job->Error = appStrdup(GErrorHistory);
+			GErrorHistory[0] = 0;
+		}
+	}
+
+	void Finish(CJob* Job)
+	{
+		Lock.Lock();
+		// the waiting thread may release the job as soon as the semaphore is posted, so
+		// the job shouldn't be accessed after that
+		CSemaphore* Waiter = (CSemaphore*)Job->Waiter;
+		Job->Waiter = NULL;
+		Job->State = CJob::Finished;
+		Lock.Unlock();
+		if (Waiter) Waiter->Post();
+	}
+
+#if _WIN32
+	static DWORD WINAPI WorkerThread(void* Param)
+#else
+	static void* WorkerThread(void* Param)
+#endif
+	{
+		CJobQueue* Queue = (CJobQueue*)Param;
+		while (true)
+		{
+			Queue->Signal.Wait();
+			Queue->Lock.Lock();
+			CJob* Job = Queue->Head;
+			if (Job)
+			{
+				Queue->Remove(Job);
+				Job->State = CJob::Running;
+			}
+			Queue->Lock.Unlock();
+			// the job could be already taken by the thread which is waiting for it
+			if (!Job) continue;
+			Execute(Job);
+			Queue->Finish(Job);
+		}
+		return 0;
+	}
+};
+
+static CJobQueue GJobQueue;
+
+// Used by appWaitJob(), one per thread. Not released.
+static THREAD_LOCAL CSemaphore* GWaitSignal = NULL;
+
+
+void appQueueJob(CJob* Job)
+{
+	guard(appQueueJob);
+	assert(Job->State == CJob::Idle || Job->State == CJob::Finished);
+	assert(!Job->Error);
+
+	TScopeLock<CMutex> Lock(GJobQueue.Lock);
+	GJobQueue.StartWorkers();
+	Job->State = CJob::Queued;
+	GJobQueue.Push(Job);
+	// when there's no worker threads, job will be executed in appWaitJob()
+	if (GJobQueue.NumWorkers > 0)
+		GJobQueue.Signal.Post();
+
+	unguard;
+}
+
+void appWaitJob(CJob* Job)
+{
+	guard(appWaitJob);
+
+	GJobQueue.Lock.Lock();
+	if (Job->State == CJob::Queued)
+	{
+		// the job wasn't started yet, execute it in this thread
+		GJobQueue.Remove(Job);
+		Job->State = CJob::Running;
+		GJobQueue.Lock.Unlock();
+		CJobQueue::Execute(Job);
+		Job->State = CJob::Finished;
+	}
+	else if (Job->State == CJob::Running)
+	{
+		if (!GWaitSignal) GWaitSignal = new CSemaphore;
+		Job->Waiter = GWaitSignal;
+		GJobQueue.Lock.Unlock();
+		GWaitSignal->Wait();
+	}
+	else
+	{
+		GJobQueue.Lock.Unlock();
+	}
+	assert(Job->State == CJob::Finished);
+
+	if (Job->Error)
+	{
+		char History[ARRAY_COUNT(GErrorHistory)];
+		appStrncpyz(History, Job->Error, ARRAY_COUNT(History));
+		appFree(Job->Error);
+		Job->Error = NULL;
+		appRaiseErrorHistory(History);
+	}
+
+	unguard;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Parallel for
+-----------------------------------------------------------------------------*/
+
+struct CParallelForContext
+{
+	void		(*Func)(int, void*);
+	void*		Param;
+	int			Count;
+	volatile int NextIndex;
+	// error with lowest index
+	CSpinLock	ErrorLock;
+	volatile int ErrorIndex;
+	char*		Error;
+
+	void Run()
+	{
+		while (ErrorIndex >= Count)			// stop when any call failed
+		{
+			// indices are taken in increasing order, so when some call fails, all calls with lower
+			// indices are already started, and we'll report the same error as sequential code would
+			int Index = appInterlockedIncrement(&NextIndex) - 1;
+			if (Index >= Count) break;
+			if (!CallWithErrorCatching(Func, Index, Param))
+			{
+				ErrorLock.Lock();
+				if (Index < ErrorIndex)
+				{
+					if (Error) appFree(Error);
+					Error = appStrdup(GErrorHistory);
+					ErrorIndex = Index;
+				}
+				ErrorLock.Unlock();
+				GErrorHistory[0] = 0;
+			}
+		}
+	}
+};
+
+struct CParallelForJob : public CJob
+{
+	CParallelForContext* Context;
+
+	virtual void Execute()
+	{
+		Context->Run();
+	}
+};
+
+void appParallelFor(int Count, void (*Func)(int Index, void* Param), void* Param)
+{
+	guard(appParallelFor);
+
+	int NumJobs = min(appGetNumThreads(), Count) - 1;
+	if (NumJobs <= 0)
+	{
+		// sequential execution
+		for (int i = 0; i < Count; i++)
+			Func(i, Param);
+		return;
+	}
+
+	CParallelForContext Context;
+	Context.Func = Func;
+	Context.Param = Param;
+	Context.Count = Count;
+	Context.NextIndex = 0;
+	Context.ErrorLock.Locked = 0;
+	Context.ErrorIndex = Count;
+	Context.Error = NULL;
+
+	CParallelForJob* Jobs = new CParallelForJob[NumJobs];
+	for (int i = 0; i < NumJobs; i++)
+	{
+		Jobs[i].Context = &Context;
+		appQueueJob(&Jobs[i]);
+	}
+	Context.Run();
+	for (int i = 0; i < NumJobs; i++)
+		appWaitJob(&Jobs[i]);			// Run() doesn't raise errors
+	delete[] Jobs;
+
+	if (Context.Error)
+	{
+		char History[ARRAY_COUNT(GErrorHistory)];
+		appStrncpyz(History, Context.Error, ARRAY_COUNT(History));
+		appFree(Context.Error);
+		appRaiseErrorHistory(History);
+	}
+
+	unguard;
+}
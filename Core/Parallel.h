@@ -0,0 +1,199 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+/*-----------------------------------------------------------------------------
+	Simple worker thread pool
+
+	Most of the code is single-threaded. Jobs may use memory allocation,
+	appStrdupPool() and appError() (errors are passed to the waiting thread),
+	everything else should be treated as not thread-safe.
+-----------------------------------------------------------------------------*/
+
+// Interlocked operations
+
+#if _MSC_VER
+
+FORCEINLINE int appInterlockedIncrement(volatile int* Value)
+{
+	return _InterlockedIncrement((volatile long*)Value);
+}
+
+FORCEINLINE int appInterlockedAdd(volatile int* Value, int Amount)
+{
+	return _InterlockedExchangeAdd((volatile long*)Value, Amount) + Amount;
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t* Value, size_t Amount)
+{
+#if _WIN64
+	return _InterlockedExchangeAdd64((volatile __int64*)Value, Amount) + Amount;
+#else
+	return _InterlockedExchangeAdd((volatile long*)Value, Amount) + Amount;
+#endif
+}
+
+FORCEINLINE int appInterlockedExchange(volatile int* Value, int NewValue)
+{
+	return _InterlockedExchange((volatile long*)Value, NewValue);
+}
+
+FORCEINLINE void* appInterlockedExchangePtr(void* volatile* Value, void* NewValue)
+{
+	return _InterlockedExchangePointer(Value, NewValue);
+}
+
+#else
+
+FORCEINLINE int appInterlockedIncrement(volatile int* Value)
+{
+	return __sync_add_and_fetch(Value, 1);
+}
+
+FORCEINLINE int appInterlockedAdd(volatile int* Value, int Amount)
+{
+	return __sync_add_and_fetch(Value, Amount);
+}
+
+FORCEINLINE size_t appInterlockedAdd(volatile size_t* Value, size_t Amount)
+{
+	return __sync_add_and_fetch(Value, Amount);
+}
+
+FORCEINLINE int appInterlockedExchange(volatile int* Value, int NewValue)
+{
+	__sync_synchronize();		// __sync_lock_test_and_set() is only an acquire barrier
+	return __sync_lock_test_and_set(Value, NewValue);
+}
+
+FORCEINLINE void* appInterlockedExchangePtr(void* volatile* Value, void* NewValue)
+{
+	__sync_synchronize();
+	return __sync_lock_test_and_set(Value, NewValue);
+}
+
+#endif // _MSC_VER
+
+void appYieldThread();
+
+
+// Lightweight lock for short code fragments. Doesn't require construction, so it could be used
+// as a static variable which is accessed during static initialization.
+struct CSpinLock
+{
+	volatile int	Locked;
+
+	FORCEINLINE void Lock()
+	{
+		while (appInterlockedExchange(&Locked, 1))
+		{
+			while (Locked) appYieldThread();
+		}
+	}
+	FORCEINLINE void Unlock()
+	{
+		appInterlockedExchange(&Locked, 0);
+	}
+};
+
+template<class T>
+class TScopeLock
+{
+public:
+	FORCEINLINE TScopeLock(T& InLock)
+	:	LockObj(InLock)
+	{
+		LockObj.Lock();
+	}
+	FORCEINLINE ~TScopeLock()
+	{
+		LockObj.Unlock();
+	}
+
+protected:
+	T&			LockObj;
+};
+
+
+// Recursive mutex
+class CMutex
+{
+public:
+	CMutex();
+	~CMutex();
+	void Lock();
+	void Unlock();
+
+protected:
+	// storage for CRITICAL_SECTION or pthread_mutex_t, so we don't need to include system headers here
+	void*		Handle[8];
+};
+
+
+class CJob
+{
+public:
+	CJob()
+	:	State(Idle)
+	,	Next(NULL)
+	,	Waiter(NULL)
+	,	Error(NULL)
+	{}
+	virtual ~CJob()
+	{
+		if (Error) appFree(Error);
+	}
+
+	virtual void Execute() = 0;
+
+	FORCEINLINE bool IsFinished() const
+	{
+		return State == Finished;
+	}
+
+protected:
+	enum EState
+	{
+		Idle,
+		Queued,
+		Running,
+		Finished,
+	};
+	volatile int State;
+	CJob*		Next;			// queue link
+	void*		Waiter;			// thread waiting for this job
+	char*		Error;			// GErrorHistory of failed job
+
+	friend void appQueueJob(CJob* Job);
+	friend void appWaitJob(CJob* Job);
+	friend struct CJobQueue;
+};
+
+// Number of threads used for jobs, including the calling thread. Default is the number of CPU cores.
+int appGetNumThreads();
+// Should be called before any job is queued. Value <= 1 will make all jobs to be executed by the waiting thread.
+void appSetNumThreads(int Num);
+
+// Start execution of the job on a worker thread. The job object should stay alive until appWaitJob() is called.
+void appQueueJob(CJob* Job);
+// Wait for job completion. When the job is still queued, it is executed by the calling thread. If the job has
+// failed, its error is raised in the calling thread.
+void appWaitJob(CJob* Job);
+
+// Call Func(Index, Param) for Index in range [0, Count) using all threads, and wait for completion. When some
+// calls fail, the error of the call with lowest index is raised.
+void appParallelFor(int Count, void (*Func)(int Index, void* Param), void* Param);
+
+template<typename F>
+FORCEINLINE void ParallelFor(int Count, const F& Func)
+{
+	struct Wrapper
+	{
+		static void Call(int Index, void* Param)
+		{
+			(*(const F*)Param)(Index);
+		}
+	};
+	appParallelFor(Count, Wrapper::Call, (void*)&Func);
+}
+
+#endif // __PARALLEL_H__
@@ -1,4 +1,5 @@
 #include "Core.h"
+#include "Parallel.h"
 
 #if _WIN32
 #include <signal.h>					// abort handler
@@ -398,6 +399,11 @@ static void PrintUsage()
 #endif
 			"    -aes=key        provide AES decryption key for encrypted pak files,\n"
 			"                    key is ASCII or hex string (hex format is 0xAABBCCDD)\n"
+			"    -cache=PATH     directory for cached pak file indices and package info\n"
+			"    -nocache        disable caching of pak file indices and package info\n"
+			"    -threads=N      number of threads used for loading, 1 = single-threaded\n"
+			"    -prefetch=KB    read exports up to this size with a single read, default is 4096\n"
+			"    -noprefetch     disable prefetching of export data\n"
 			"\n"
 			"Compatibility options:\n"
 			"    -nomesh         disable loading of SkeletalMesh classes in a case of\n"
@@ -849,6 +855,27 @@ int main(int argc, char **argv)
 		{
 			GSettings.Export.SetPath(opt+4);
 		}
+		else if (!strnicmp(opt, "cache=", 6))
+		{
+			GSettings.Startup.SetCachePath(opt+6);
+		}
+		else if (!stricmp(opt, "nocache"))
+		{
+			GSettings.Startup.SetCachePath("");
+		}
+		else if (!strnicmp(opt, "threads=", 8))
+		{
+			appSetNumThreads(atoi(opt+8));
+		}
+		else if (!strnicmp(opt, "prefetch=", 9))
+		{
+			int SizeKb = atoi(opt+9);
+			GExportPrefetchSize = bound(SizeKb, 0, 1 << 20) << 10;
+		}
+		else if (!stricmp(opt, "noprefetch"))
+		{
+			GExportPrefetchSize = 0;
+		}
 		else if (!strnicmp(opt, "game=", 5))
 		{
 			int tag = FindGameTag(opt+5);
@@ -952,6 +979,7 @@ int main(int argc, char **argv)
 
 	// apply some GSettings
 	GForceGame = GSettings.Startup.GameOverride;	// force game fore scanning any game files
+	appSetCacheDirectory(*GSettings.Startup.CachePath);
 	if (hasRootDir)
 		appSetRootDirectory(*GSettings.Startup.GamePath);
 	GForcePlatform = GSettings.Startup.Platform;
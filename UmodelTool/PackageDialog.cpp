@@ -97,32 +97,21 @@ public:
 	#endif
 	}
 
-	void FillPackageList(UIPackageDialog::PackageList& InPackages, const char* directory, const char* packageFilter)
+	// InPackages should contain packages from a single directory
+	void FillPackageList(UIPackageDialog::PackageList& InPackages, const char* packageFilter)
 	{
 		LockUpdate();
 
 		RemoveAllItems();
-		Packages.Empty();
+		Packages.Empty(InPackages.Num());
 
 		CFilter filter(packageFilter);
 
 		for (int i = 0; i < InPackages.Num(); i++)
 		{
 			const CGameFileInfo* package = InPackages[i];
-			char buffer[MAX_PACKAGE_PATH];
-			appStrncpyz(buffer, package->RelativeName, ARRAY_COUNT(buffer));
-			char* s = strrchr(buffer, '/');
-			if (s) *s++ = 0;
-			if ((!s && !directory[0]) ||				// root directory
-				(s && !strcmp(buffer, directory)))		// another directory
-			{
-				const char* packageName = s ? s : buffer;
-				if (filter.Filter(packageName))
-				{
-					// this package is in selected directory
-					AddPackage(package);
-				}
-			}
+			if (filter.Filter(package->ShortFilename))
+				AddPackage(package);
 		}
 
 		UnlockUpdate(); // this will call Repaint()
@@ -296,6 +285,11 @@ void UIPackageDialog::SelectPackage(UnPackage* package)
 	}
 }
 
+static int CompareFolderNames(const char** A, const char** B)
+{
+	return stricmp(*A, *B);
+}
+
 void UIPackageDialog::InitUI()
 {
 	guard(UIPackageDialog::InitUI);
@@ -349,28 +343,17 @@ void UIPackageDialog::InitUI()
 			}, Packages);
 	}
 
-	// add paths of all found packages to the directory tree
+	// add all directories with packages to the directory tree, sorted by name
 	if (SelectedPackages.Num()) DirectorySelected = true;
-	char prevPath[MAX_PACKAGE_PATH], path[MAX_PACKAGE_PATH];
-	prevPath[0] = 0;
-	// Make a copy of package list sorted by name, to ensure directory tree is always sorted.
-	// Using a copy to not affect package sorting used before.
-	PackageList SortedPackages;
-	CopyArray(SortedPackages, Packages);
-	SortPackages(SortedPackages, UIPackageList::COLUMN_Name, false);
-	for (int i = 0; i < Packages.Num(); i++)
+	TArray<const char*> Folders;
+	appGetGameFolders(Folders);
+	QSort(Folders.GetData(), Folders.Num(), CompareFolderNames);
+	for (int i = 0; i < Folders.Num(); i++)
 	{
-		appStrncpyz(path, SortedPackages[i]->RelativeName, ARRAY_COUNT(path));
-		char* s = strrchr(path, '/');
-		if (s)
-		{
-			*s = 0;
-			// simple optimization - avoid calling PackageTree->AddItem() too frequently (assume package list is sorted)
-			if (!strcmp(prevPath, path)) continue;
-			strcpy(prevPath, path);
-			// add a directory to TreeView
+		const char* path = Folders[i];
+		// root directory is always present in TreeView
+		if (path[0])
 			PackageTree->AddItem(path);
-		}
 		if (!DirectorySelected)
 		{
 			// find the first directory with packages, but don't select /Game/Engine subdirectories by default
@@ -378,7 +361,7 @@ void UIPackageDialog::InitUI()
 			if (!isUE4EnginePath && (stricmp(path, *SelectedDir) < 0 || SelectedDir.IsEmpty()))
 			{
 				// set selection to the first directory
-				SelectedDir = s ? path : "";
+				SelectedDir = path;
 			}
 		}
 	}
@@ -517,7 +500,11 @@ void UIPackageDialog::OnTreeItemSelected(UITreeView* sender, const char* text)
 {
 	SelectedDir = text;
 	DirectorySelected = true;
-	PackageListbox->FillPackageList(Packages, text, *PackageFilter);
+	// get packages from the directory index instead of scanning the whole package list
+	PackageList FolderPackages;
+	appGetGameFolderFiles(text, FolderPackages);
+	SortPackages(FolderPackages, SortedColumn, ReverseSort);
+	PackageListbox->FillPackageList(FolderPackages, *PackageFilter);
 }
 
 void UIPackageDialog::OnFlatViewChanged(UICheckbox* sender, bool value)
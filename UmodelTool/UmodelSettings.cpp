@@ -12,6 +12,7 @@
 
 #define CONFIG_FILE			"umodel.cfg"
 #define EXPORT_DIRECTORY	"UmodelExport"
+#define CACHE_DIRECTORY		"UmodelCache"
 
 static void SetPathOption(FString& where, const char* value)
 {
@@ -77,6 +78,17 @@ void CStartupSettings::SetPath(const char* path)
 	SetPathOption(GamePath, path);
 }
 
+void CStartupSettings::SetCachePath(const char* path)
+{
+	if (!path || !path[0])
+	{
+		// empty path disables caching
+		CachePath = "";
+		return;
+	}
+	SetPathOption(CachePath, path);
+}
+
 void CStartupSettings::Reset()
 {
 	GameOverride = GAME_UNKNOWN;
@@ -94,6 +106,8 @@ void CStartupSettings::Reset()
 
 	PackageCompression = 0;
 	Platform = PLATFORM_UNKNOWN;
+
+	SetCachePath(CACHE_DIRECTORY);
 }
 
 
@@ -24,6 +24,9 @@ struct CStartupSettings
 	int				PackageCompression;
 	int				Platform;
 
+	// directory for persistent cache files; not stored in config
+	FString			CachePath;
+
 	BEGIN_PROP_TABLE
 		PROP_STRING(GamePath)
 		PROP_INT(GameOverride)
@@ -45,6 +48,7 @@ struct CStartupSettings
 	}
 
 	void SetPath(const char* path);
+	void SetCachePath(const char* path);
 
 	void Reset();
 };
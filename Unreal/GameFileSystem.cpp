@@ -1,6 +1,7 @@
 #include "Core.h"
 #include "UnCore.h"
 #include "GameFileSystem.h"
+#include "Parallel.h"
 
 #include "UnArchiveObb.h"
 #include "UnArchivePak.h"
@@ -18,8 +19,6 @@
 	Game file system
 -----------------------------------------------------------------------------*/
 
-#define MAX_FOREIGN_FILES		32768
-
 char GRootDirectory[MAX_PACKAGE_PATH];
 
 
@@ -140,14 +139,25 @@ static TArray<CGameFileInfo*> GameFiles;
 int GNumPackageFiles = 0;
 int GNumForeignFiles = 0;
 
-#define GAME_FILE_HASH_SIZE		16384
-#define GAME_FILE_HASH_MASK		(GAME_FILE_HASH_SIZE-1)
+#define GAME_FILE_HASH_MIN_SIZE	16384			// initial number of slots in hash table, should be power of 2
 
 //#define PRINT_HASH_DISTRIBUTION	1
+//#define PROFILE_FILE_LOOKUP		1
 //#define DEBUG_HASH				1
 //#define DEBUG_HASH_NAME			"21680"
 
-static CGameFileInfo* GGameFileHash[GAME_FILE_HASH_SIZE];
+// Open-addressing hash table, one slot per distinct short filename (without extension). Files
+// with the same name but different path or extension are linked with CGameFileInfo::HashNext.
+struct CGameFileHashSlot
+{
+	uint32			Hash;						// full hash of lowercased name, 0 for empty slot
+	int				NameLen;
+	CGameFileInfo*	Files;
+};
+
+static CGameFileHashSlot* GGameFileHash = NULL;
+static int GGameFileHashSize = 0;				// number of slots, power of 2
+static int GGameFileHashCount = 0;				// number of used slots
 
 
 #if UNREAL3
@@ -157,142 +167,421 @@ static int            GStartupPackageInfoWeight = 0;
 #endif
 
 
-static int GetHashForFileName(const char* FileName, bool stripExtension)
+// Hash of the first 'len' characters of the name, never 0
+static uint32 GetHashForFileName(const char* ShortFilename, int len)
 {
-	const char* s1 = strrchr(FileName, '/'); // assume path delimiters are normalized
-	s1 = (s1 != NULL) ? s1 + 1 : FileName;
-	const char* s2 = stripExtension ? strrchr(s1, '.') : NULL;
-	int len = (s2 != NULL) ? s2 - s1 : strlen(s1);
-
-	uint16 hash = 0;
-	for (int i = 0; i < len; i++)
-	{
-		char c = s1[i];
-		if (c >= 'A' && c <= 'Z') c += 'a' - 'A'; // lowercase a character
-		hash = ROL16(hash, 5) - hash + ((c << 4) + c ^ 0x13F);	// some crazy hash function
-	}
-//	hash += (len << 6) - len;
-	hash &= GAME_FILE_HASH_MASK;
+	uint32 hash = appStrihash(ShortFilename, len);
+	if (hash == 0) hash = 1;					// 0 is reserved for empty slots
 #ifdef DEBUG_HASH_NAME
-	if (strstr(FileName, DEBUG_HASH_NAME))
-		printf("-> hash[%s] (%s,%d) -> %X\n", FileName, s1, len, hash);
+	if (strstr(ShortFilename, DEBUG_HASH_NAME))
+		printf("-> hash[%s] (%d) -> %X\n", ShortFilename, len, hash);
 #endif
 	return hash;
 }
 
+// Length of the filename excluding the extension
+static int GetFileNameLength(const CGameFileInfo* info)
+{
+	return info->Extension ? info->Extension - 1 - info->ShortFilename : strlen(info->ShortFilename);
+}
+
+// Returns slot with the same name, or an empty slot where this name should be placed. Returns NULL
+// when hash table is not allocated yet.
+static CGameFileHashSlot* FindGameFileSlot(const char* ShortFilename, int len, uint32 hash)
+{
+	if (!GGameFileHash) return NULL;
+	int mask = GGameFileHashSize - 1;
+	for (int index = hash & mask; /* empty */; index = (index + 1) & mask)
+	{
+		CGameFileHashSlot* slot = &GGameFileHash[index];
+		if (!slot->Hash) return slot;
+		if (slot->Hash == hash && slot->NameLen == len && !strnicmp(slot->Files->ShortFilename, ShortFilename, len))
+			return slot;
+	}
+}
+
+static void ResizeGameFileHash(int newSize)
+{
+	guard(ResizeGameFileHash);
+
+	CGameFileHashSlot* oldHash = GGameFileHash;
+	int oldSize = GGameFileHashSize;
+	GGameFileHash = (CGameFileHashSlot*)appMalloc(newSize * sizeof(CGameFileHashSlot));
+	GGameFileHashSize = newSize;
+	// rehash, all names are distinct here
+	int mask = newSize - 1;
+	for (int i = 0; i < oldSize; i++)
+	{
+		const CGameFileHashSlot& slot = oldHash[i];
+		if (!slot.Hash) continue;
+		int index = slot.Hash & mask;
+		while (GGameFileHash[index].Hash)
+			index = (index + 1) & mask;
+		GGameFileHash[index] = slot;
+	}
+	if (oldHash) appFree(oldHash);
+
+	unguard;
+}
+
 #if PRINT_HASH_DISTRIBUTION
 
 static void PrintHashDistribution()
 {
-	int hashCounts[1024];
-	memset(hashCounts, 0, sizeof(hashCounts));
-	for (int hash = 0; hash < GAME_FILE_HASH_SIZE; hash++)
+	// print distribution of probe sequence lengths
+	int probeCounts[64];
+	memset(probeCounts, 0, sizeof(probeCounts));
+	int mask = GGameFileHashSize - 1;
+	for (int index = 0; index < GGameFileHashSize; index++)
 	{
-		int count = 0;
-		for (CGameFileInfo* info = GGameFileHash[hash]; info; info = info->HashNext)
-			count++;
-		assert(count < ARRAY_COUNT(hashCounts));
-		hashCounts[count]++;
+		const CGameFileHashSlot& slot = GGameFileHash[index];
+		if (!slot.Hash) continue;
+		int probes = ((index - slot.Hash) & mask) + 1;
+		probeCounts[min(probes, ARRAY_COUNT(probeCounts) - 1)]++;
 	}
-	appPrintf("Filename hash distribution:\n");
-	for (int i = 0; i < ARRAY_COUNT(hashCounts); i++)
-		if (hashCounts[i] > 0)
-			appPrintf("%d -> %d\n", i, hashCounts[i]);
+	appPrintf("Filename hash: %d names in %d slots, probe distribution:\n", GGameFileHashCount, GGameFileHashSize);
+	for (int i = 0; i < ARRAY_COUNT(probeCounts); i++)
+		if (probeCounts[i] > 0)
+			appPrintf("%d -> %d\n", i, probeCounts[i]);
 }
 
 #endif // PRINT_HASH_DISTRIBUTION
 
+#if PROFILE_FILE_LOOKUP
 
-//!! add define USE_VFS = SUPPORT_ANDROID || UNREAL4, perhaps || SUPPORT_IOS
+static void ProfileFileLookup()
+{
+	// measure throughput of appFindGameFile() for hits (full and short names) and misses
+	const int NumPasses = 16;
+	int numFound = 0, numLookups = 0;
+	char missName[MAX_PACKAGE_PATH];
+	int startTime = appMilliseconds();
+	for (int pass = 0; pass < NumPasses; pass++)
+	{
+		for (int i = 0; i < GameFiles.Num(); i++)
+		{
+			const CGameFileInfo* info = GameFiles[i];
+			if (appFindGameFile(info->RelativeName)) numFound++;
+			if (appFindGameFile(info->ShortFilename)) numFound++;
+			appSprintf(ARRAY_ARG(missName), "%s_", info->RelativeName);
+			if (appFindGameFile(missName)) numFound++;
+			numLookups += 3;
+		}
+	}
+	int timeDelta = appMilliseconds() - startTime;
+	appPrintf("Filename lookup: %d lookups (%d found) in %.3f sec, %.0f lookups/sec\n",
+		numLookups, numFound, timeDelta / 1000.0f, timeDelta ? numLookups * 1000.0f / timeDelta : 0.0f);
+}
 
-//?? TODO: always returns 'true' now, can change the function prototype. 'false' was used when number of files was too large.
-void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs)
+#endif // PROFILE_FILE_LOOKUP
+
+
+/*-----------------------------------------------------------------------------
+	Directory index
+-----------------------------------------------------------------------------*/
+
+// Tree of directories, used for fast directory listing and for wildcard queries with a path.
+// Directory names are compared case-insensitively, like file names.
+struct CGameFolderInfo
 {
-	guard(appRegisterGameFile);
+	const char*		Path;						// relative to root directory, without trailing slash; "" for root
+	int				PathLen;
+	uint32			Hash;
+	int				NumPackages;				// number of packages in this directory, without subdirectories
+	CGameFolderInfo* Parent;
+	CGameFolderInfo* HashNext;
+	TArray<CGameFolderInfo*> Children;
+	TArray<CGameFileInfo*> Files;				// in registration order
+};
 
-//	printf("..file %s\n", FullName);
+#define GAME_FOLDER_HASH_MIN_SIZE	1024		// should be power of 2
+
+static TArray<CGameFolderInfo*> GameFolders;
+static CGameFolderInfo** GGameFolderHash = NULL;
+static int GGameFolderHashSize = 0;
 
-	if (!parentVfs)		// no nested VFSs
+static void ResizeGameFolderHash(int newSize)
+{
+	if (GGameFolderHash) appFree(GGameFolderHash);
+	GGameFolderHash = (CGameFolderInfo**)appMalloc(newSize * sizeof(CGameFolderInfo*));
+	GGameFolderHashSize = newSize;
+	for (int i = 0; i < GameFolders.Num(); i++)
+	{
+		CGameFolderInfo* folder = GameFolders[i];
+		int index = folder->Hash & (newSize - 1);
+		folder->HashNext = GGameFolderHash[index];
+		GGameFolderHash[index] = folder;
+	}
+}
+
+// Find directory by the first 'len' characters of 'Path'. When 'create' is true, missing directory
+// will be created together with all its parent directories.
+static CGameFolderInfo* FindGameFolder(const char* Path, int len, bool create)
+{
+	uint32 hash = GetHashForFileName(Path, len);
+	if (GGameFolderHash)
 	{
-		const char* ext = strrchr(FullName, '.');
-		if (ext)
+		for (CGameFolderInfo* folder = GGameFolderHash[hash & (GGameFolderHashSize - 1)]; folder; folder = folder->HashNext)
 		{
-			guard(MountVFS);
+			if (folder->Hash == hash && folder->PathLen == len && !strnicmp(folder->Path, Path, len))
+				return folder;
+		}
+	}
+	if (!create) return NULL;
+
+	CGameFolderInfo* parent = NULL;
+	if (len > 0)
+	{
+		// find parent directory, it is the root one when there's no slash
+		int parentLen = len - 1;
+		while (parentLen > 0 && Path[parentLen] != '/')
+			parentLen--;
+		parent = FindGameFolder(Path, parentLen, true);
+	}
 
-			ext++;
-			FVirtualFileSystem* vfs = NULL;
-			FArchive* reader = NULL;
+	char buf[MAX_PACKAGE_PATH];
+	appStrncpyz(buf, Path, min(len + 1, ARRAY_COUNT(buf)));
+
+	CGameFolderInfo* folder = new CGameFolderInfo;
+	folder->Path = appStrdupPool(buf);
+	folder->PathLen = len;
+	folder->Hash = hash;
+	folder->NumPackages = 0;
+	folder->Parent = parent;
+	if (parent) parent->Children.Add(folder);
+	GameFolders.Add(folder);
+
+	if (GameFolders.Num() > GGameFolderHashSize)
+	{
+		// this will link the new folder too
+		ResizeGameFolderHash(max(GGameFolderHashSize * 2, GAME_FOLDER_HASH_MIN_SIZE));
+	}
+	else
+	{
+		int index = hash & (GGameFolderHashSize - 1);
+		folder->HashNext = GGameFolderHash[index];
+		GGameFolderHash[index] = folder;
+	}
+	return folder;
+}
 
+static void AddFileToGameFolder(CGameFileInfo* info)
+{
+	int pathLen = info->ShortFilename > info->RelativeName ? info->ShortFilename - info->RelativeName - 1 : 0;
+	CGameFolderInfo* folder = FindGameFolder(info->RelativeName, pathLen, true);
+	folder->Files.Add(info);
+	if (info->IsPackage) folder->NumPackages++;
+}
+
+static void CollectGameFolderFiles(const CGameFolderInfo* folder, TArray<const CGameFileInfo*>& Files, bool Recurse, const char* Ext)
+{
+	for (int i = 0; i < folder->Files.Num(); i++)
+	{
+		const CGameFileInfo* info = folder->Files[i];
+		if (!Ext)
+		{
+			if (!info->IsPackage) continue;
+		}
+		else
+		{
+			if (!info->Extension || stricmp(info->Extension, Ext) != 0) continue;
+		}
+		Files.Add(info);
+	}
+	if (Recurse)
+	{
+		for (int i = 0; i < folder->Children.Num(); i++)
+			CollectGameFolderFiles(folder->Children[i], Files, true, Ext);
+	}
+}
+
+static int CompareFileIndex(const CGameFileInfo* const* A, const CGameFileInfo* const* B)
+{
+	return (*A)->FileIndex - (*B)->FileIndex;
+}
+
+bool appGetGameFolderFiles(const char *Path, TArray<const CGameFileInfo*>& Files, bool Recurse, const char *Ext)
+{
+	guard(appGetGameFolderFiles);
+
+	const CGameFolderInfo* folder = FindGameFolder(Path, strlen(Path), false);
+	if (!folder) return false;
+
+	int firstFile = Files.Num();
+	CollectGameFolderFiles(folder, Files, Recurse, Ext);
+	if (Recurse && folder->Children.Num())
+	{
+		// restore registration order of files from different directories
+		QSort<const CGameFileInfo*>(Files.GetData() + firstFile, Files.Num() - firstFile, CompareFileIndex);
+	}
+	return true;
+
+	unguardf("%s", Path);
+}
+
+void appGetGameFolders(TArray<const char*>& Folders)
+{
+	for (int i = 0; i < GameFolders.Num(); i++)
+	{
+		const CGameFolderInfo* folder = GameFolders[i];
+		if (folder->NumPackages)
+			Folders.Add(folder->Path);
+	}
+}
+
+
+//!! add define USE_VFS = SUPPORT_ANDROID || UNREAL4, perhaps || SUPPORT_IOS
+
+static bool IsVFSFile(const char* FullName)
+{
+	const char* ext = strrchr(FullName, '.');
+	if (!ext) return false;
+	ext++;
 #if SUPPORT_ANDROID
-			if (!stricmp(ext, "obb"))
-			{
-				GForcePlatform = PLATFORM_ANDROID;
-				reader = new FFileReader(FullName);
-				if (!reader) return;
-				reader->Game = GAME_UE3;
-				vfs = new FObbVFS(FullName);
-			}
+	if (!stricmp(ext, "obb")) return true;
+#endif
+#if UNREAL4
+	if (!stricmp(ext, "pak")) return true;
+#endif
+	//!! process other VFS types here
+	return false;
+}
+
+// Open a container file and read its directory. Returns NULL if the file has unknown format. When
+// bCanAskUser is false (worker thread), files which require user interaction are not mounted, and
+// bDeferred is set - these files should be mounted again from the main thread.
+static FVirtualFileSystem* MountVFS(const char* FullName, bool bCanAskUser, bool& bDeferred)
+{
+	guard(MountVFS);
+
+	bDeferred = false;
+	const char* ext = strrchr(FullName, '.') + 1;
+
+	FVirtualFileSystem* vfs = NULL;
+	FArchive* reader = NULL;
+
+#if SUPPORT_ANDROID
+	if (!stricmp(ext, "obb"))
+	{
+		reader = new FFileReader(FullName);
+		reader->Game = GAME_UE3;
+		vfs = new FObbVFS(FullName);
+	}
 #endif // SUPPORT_ANDROID
 #if UNREAL4
-			if (!stricmp(ext, "pak"))
-			{
-				reader = new FFileReader(FullName);
-				if (!reader) return;
-				reader->Game = GAME_UE4_BASE;
-				vfs = new FPakVFS(FullName);
-			}
+	if (!stricmp(ext, "pak"))
+	{
+		reader = new FFileReader(FullName);
+		reader->Game = GAME_UE4_BASE;
+		FPakVFS* pakVfs = new FPakVFS(FullName);
+		pakVfs->AllowAesKeyPrompt = bCanAskUser;
+		vfs = pakVfs;
+	}
 #endif // UNREAL4
-			//!! process other VFS types here
-			//!! note: VFS pointer is not stored in any global list, and not released upon program exit
-			if (vfs)
-			{
-				assert(reader);
-				// read VF directory
-				if (!vfs->AttachReader(reader))
-				{
-					// something goes wrong
-					appPrintf("File %s has unknown format\n", FullName);
-					delete vfs;
-					delete reader;
-					return;
-				}
-				// add game files
-				int NumVFSFiles = vfs->NumFiles();
-				for (int i = 0; i < NumVFSFiles; i++)
-				{
-					appRegisterGameFile(vfs->FileName(i), vfs);
-				}
-			}
+	//!! process other VFS types here
+	//!! note: VFS pointer is not stored in any global list, and not released upon program exit
+	assert(vfs && reader);
 
-			unguard;
-		}
+	// read VF directory
+	if (!vfs->AttachReader(reader))
+	{
+		// something goes wrong
+#if UNREAL4
+		if (!stricmp(ext, "pak") && static_cast<FPakVFS*>(vfs)->NeedsAesKey)
+			bDeferred = true;
+#endif
+		delete vfs;
+		delete reader;
+		return NULL;
+	}
+	return vfs;
+
+	unguardf("%s", FullName);
+}
+
+static void AddGameFile(const char *FullName, FVirtualFileSystem* parentVfs, int64 vfsTime = 0);
+
+// Register all files from mounted VFS. Returns false when VFS wasn't mounted.
+static bool RegisterVFSFiles(const char *FullName, FVirtualFileSystem* vfs)
+{
+	if (!vfs)
+	{
+		appPrintf("File %s has unknown format\n", FullName);
+		return false;
+	}
+
+	const char* ext = strrchr(FullName, '.') + 1;
+#if SUPPORT_ANDROID
+	if (!stricmp(ext, "obb"))
+		GForcePlatform = PLATFORM_ANDROID;
+#endif
+#if UNREAL4
+	if (!stricmp(ext, "pak"))
+		static_cast<FPakVFS*>(vfs)->PrintStats();
+#endif
+
+	// add game files
+	int64 vfsSize, vfsTime = 0;
+	appGetFileSizeAndTime(FullName, vfsSize, vfsTime);
+	int NumVFSFiles = vfs->NumFiles();
+	for (int i = 0; i < NumVFSFiles; i++)
+	{
+		AddGameFile(vfs->FileName(i), vfs, vfsTime);
 	}
+	return true;
+}
 
-	bool IsPackage = false;
+//?? TODO: always returns 'true' now, can change the function prototype. 'false' was used when number of files was too large.
+void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs)
+{
+	guard(appRegisterGameFile);
+
+//	printf("..file %s\n", FullName);
+
+	if (!parentVfs && IsVFSFile(FullName))		// no nested VFSs
+	{
+		bool bDeferred;
+		FVirtualFileSystem* vfs = MountVFS(FullName, true, bDeferred);
+		if (!RegisterVFSFiles(FullName, vfs))
+			return;
+	}
+
+	AddGameFile(FullName, parentVfs);
+
+	unguardf("%s", FullName);
+}
+
+// Check whether the file should be registered. Counts unknown files.
+static bool IsGameFile(const char *FullName, FVirtualFileSystem* parentVfs, bool& IsPackage)
+{
+	IsPackage = false;
 	if (FindExtension(FullName, ARRAY_ARG(PackageExtensions)))
 	{
 		IsPackage = true;
+		return true;
 	}
-	else
-	{
 #if HAS_SUPPORT_FILES
-		if (!FindExtension(FullName, ARRAY_ARG(KnownExtensions)))
+	if (FindExtension(FullName, ARRAY_ARG(KnownExtensions)))
+		return true;
 #endif
-		{
-			// ignore any unknown files inside VFS
-			if (parentVfs) return;
-			// ignore unknown files inside "cooked" or "content" directories
-			if (appStristr(FullName, "cooked") || appStristr(FullName, "content")) return;
-			// perhaps this file was exported by our tool - skip it
-			if (!FindExtension(FullName, ARRAY_ARG(SkipExtensions)))
-			{
-				// unknown file type
-				if (++GNumForeignFiles >= MAX_FOREIGN_FILES)
-					appError("Too many unknown files - bad root directory (%s)?", GRootDirectory);
-			}
-			return;
-		}
+	// ignore any unknown files inside VFS
+	if (parentVfs) return false;
+	// ignore unknown files inside "cooked" or "content" directories
+	if (appStristr(FullName, "cooked") || appStristr(FullName, "content")) return false;
+	// perhaps this file was exported by our tool - skip it
+	if (!FindExtension(FullName, ARRAY_ARG(SkipExtensions)))
+	{
+		// unknown file type
+		GNumForeignFiles++;
 	}
+	return false;
+}
+
+static void AddGameFile(const char *FullName, FVirtualFileSystem* parentVfs, int64 vfsTime)
+{
+	bool IsPackage;
+	if (!IsGameFile(FullName, parentVfs, IsPackage))
+		return;
 
 	// create entry
 	CGameFileInfo *info = new CGameFileInfo;
@@ -302,16 +591,10 @@ void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs)
 	if (!parentVfs)
 	{
 		// regular file
-		FILE* f = fopen(FullName, "rb");
-		if (f)
-		{
-			fseek(f, 0, SEEK_END);
-			info->Size = ftell(f);
-			fclose(f);
-		}
-		else
+		if (!appGetFileSizeAndTime(FullName, info->Size, info->Time))
 		{
 			info->Size = 0;
+			info->Time = 0;
 		}
 		// cut GRootDirectory from filename
 		const char *s = FullName + strlen(GRootDirectory) + 1;
@@ -322,6 +605,7 @@ void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs)
 	{
 		// file in virtual file system
 		info->Size = parentVfs->GetFileSize(FullName);
+		info->Time = vfsTime;
 		info->RelativeName = appStrdupPool(FullName);
 	}
 	info->SizeInKb = (info->Size + 512) / 1024;
@@ -361,9 +645,13 @@ void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs)
 #endif // UNREAL3
 
 	// insert CGameFileInfo into hash table
-	int hash = GetHashForFileName(info->ShortFilename, true);
+	if (!GGameFileHash)
+		ResizeGameFileHash(GAME_FILE_HASH_MIN_SIZE);
+	int nameLen = GetFileNameLength(info);
+	uint32 hash = GetHashForFileName(info->ShortFilename, nameLen);
+	CGameFileHashSlot* slot = FindGameFileSlot(info->ShortFilename, nameLen, hash);
 	// find if we have previously registered file with the same name
-	for (CGameFileInfo* prevInfo = GGameFileHash[hash]; prevInfo; prevInfo = prevInfo->HashNext)
+	for (CGameFileInfo* prevInfo = slot->Files; prevInfo; prevInfo = prevInfo->HashNext)
 	{
 		if (stricmp(prevInfo->RelativeName, info->RelativeName) == 0)
 		{
@@ -377,98 +665,601 @@ void appRegisterGameFile(const char *FullName, FVirtualFileSystem* parentVfs)
 		}
 	}
 
-	GameFiles.Add(info);
+	info->FileIndex = GameFiles.Add(info);
 	if (IsPackage) GNumPackageFiles++;
+	AddFileToGameFolder(info);
 
-	info->HashNext = GGameFileHash[hash];
-	GGameFileHash[hash] = info;
+	if (!slot->Files)
+	{
+		// new name
+		slot->Hash = hash;
+		slot->NameLen = nameLen;
+		GGameFileHashCount++;
+	}
+	info->HashNext = slot->Files;
+	slot->Files = info;
+
+	// keep load factor below 1/2
+	if (GGameFileHashCount * 2 > GGameFileHashSize)
+		ResizeGameFileHash(GGameFileHashSize * 2);
 
 #if DEBUG_HASH
 	printf("--> add(%s) pkg=%d hash=%X\n", info->ShortFilename, info->IsPackage, hash);
 #endif
+}
 
-	return;
 
-	unguardf("%s", FullName);
+struct CScanDirInfo
+{
+	FString			Path;
+	TArray<FStaticString<256>> Files;			// sorted
+	TArray<FStaticString<256>> Subdirs;			// sorted
+	int				FirstChild;					// index of the first subdirectory in the list of scanned directories
+};
+
+static int CompareScanNames(const FStaticString<256>& p1, const FStaticString<256>& p2)
+{
+	return stricmp(*p1, *p2);
 }
 
-static bool ScanGameDirectory(const char *dir, bool recurse)
+// Read a single directory, without recursion
+static void ReadGameDirectory(CScanDirInfo& Dir, bool recurse)
 {
-	guard(ScanGameDirectory);
+	guard(ReadGameDirectory);
 
+	const char* dir = *Dir.Path;
 	char Path[MAX_PACKAGE_PATH];
-	bool res = true;
 //	printf("Scan %s\n", dir);
 
-	TArray<FStaticString<256>> Filenames;
-	Filenames.Empty(256);
-
 #if _WIN32
 	appSprintf(ARRAY_ARG(Path), "%s/*.*", dir);
 	_finddatai64_t found;
 	intptr_t hFind = _findfirsti64(Path, &found);
-	if (hFind == -1) return true;
+	if (hFind == -1) return;
 	do
 	{
 		if (found.name[0] == '.') continue;			// "." or ".."
-		// directory -> recurse
 		if (found.attrib & _A_SUBDIR)
 		{
-			if (recurse)
-			{
-				appSprintf(ARRAY_ARG(Path), "%s/%s", dir, found.name);
-				res = ScanGameDirectory(Path, recurse);
-			}
+			if (recurse) Dir.Subdirs.Add(found.name);
 		}
 		else
 		{
-			Filenames.Add(found.name);
+			Dir.Files.Add(found.name);
 		}
-	} while (res && _findnexti64(hFind, &found) != -1);
+	} while (_findnexti64(hFind, &found) != -1);
 	_findclose(hFind);
 #else
 	DIR *find = opendir(dir);
-	if (!find) return true;
+	if (!find) return;
 	struct dirent *ent;
-	while (/*res &&*/ (ent = readdir(find)))
+	while ((ent = readdir(find)))
 	{
 		if (ent->d_name[0] == '.') continue;			// "." or ".."
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
-		// directory -> recurse
-		// note: using 'stat64' here because 'stat' ignores large files
-		struct stat64 buf;
-		if (stat64(Path, &buf) < 0) continue;			// or break?
-		if (S_ISDIR(buf.st_mode))
+		bool isDir;
+#ifdef DT_DIR
+		// most file systems report file type in directory entry, so stat() is not needed
+		if (ent->d_type == DT_DIR)
+			isDir = true;
+		else if (ent->d_type == DT_REG)
+			isDir = false;
+		else
+#endif
 		{
-			if (recurse)
-				res = ScanGameDirectory(Path, recurse);
+			// unknown type or symbolic link
+			appSprintf(ARRAY_ARG(Path), "%s/%s", dir, ent->d_name);
+			// note: using 'stat64' here because 'stat' ignores large files
+			struct stat64 buf;
+			if (stat64(Path, &buf) < 0) continue;			// or break?
+			isDir = S_ISDIR(buf.st_mode);
+		}
+		if (isDir)
+		{
+			if (recurse) Dir.Subdirs.Add(ent->d_name);
 		}
 		else
 		{
-			Filenames.Add(ent->d_name);
+			Dir.Files.Add(ent->d_name);
 		}
 	}
 	closedir(find);
 #endif
 
 	// Register files in sorted order - should be done for pak files, so patches will work.
-	Filenames.Sort([](const FStaticString<256>& p1, const FStaticString<256>& p2) -> int
+	// Subdirectories are sorted too, so the order doesn't depend on file system.
+	Dir.Files.Sort(CompareScanNames);
+	Dir.Subdirs.Sort(CompareScanNames);
+
+	unguardf("%s", *Dir.Path);
+}
+
+// Files from subdirectories come first, then files from the directory itself
+static void CollectScannedFiles(const TArray<CScanDirInfo*>& Dirs, int Index, TArray<FString>& OutFiles)
+{
+	const CScanDirInfo& Dir = *Dirs[Index];
+	for (int i = 0; i < Dir.Subdirs.Num(); i++)
+		CollectScannedFiles(Dirs, Dir.FirstChild + i, OutFiles);
+
+	char Path[MAX_PACKAGE_PATH];
+	for (int i = 0; i < Dir.Files.Num(); i++)
+	{
+		appSprintf(ARRAY_ARG(Path), "%s/%s", *Dir.Path, *Dir.Files[i]);
+		bool IsPackage;
+		if (IsVFSFile(Path) || IsGameFile(Path, NULL, IsPackage))
+			OutFiles.Add(Path);
+	}
+}
+
+// Collect files from the directory. Unknown files are dropped (and counted) here.
+// Directory tree is read level by level, directories of the same level are read in parallel.
+static bool ScanGameDirectory(const char *dir, bool recurse, TArray<FString>& OutFiles)
+{
+	guard(ScanGameDirectory);
+
+	TArray<CScanDirInfo*> Dirs;
+	CScanDirInfo* Root = new CScanDirInfo;
+	Root->Path = dir;
+	Dirs.Add(Root);
+
+	int FirstDir = 0;
+	while (FirstDir < Dirs.Num())
+	{
+		int LastDir = Dirs.Num();
+		ParallelFor(LastDir - FirstDir, [&](int i)
+			{
+				ReadGameDirectory(*Dirs[FirstDir + i], recurse);
+			});
+		// enqueue subdirectories for the next level
+		char Path[MAX_PACKAGE_PATH];
+		for (int i = FirstDir; i < LastDir; i++)
 		{
-			return stricmp(*p1, *p2) > 0;
-		});
+			CScanDirInfo* Parent = Dirs[i];
+			Parent->FirstChild = Dirs.Num();
+			for (int j = 0; j < Parent->Subdirs.Num(); j++)
+			{
+				appSprintf(ARRAY_ARG(Path), "%s/%s", *Parent->Path, *Parent->Subdirs[j]);
+				CScanDirInfo* Child = new CScanDirInfo;
+				Child->Path = Path;
+				Dirs.Add(Child);
+			}
+		}
+		FirstDir = LastDir;
+	}
 
-	for (int i = 0; i < Filenames.Num(); i++)
+	CollectScannedFiles(Dirs, 0, OutFiles);
+
+	for (int i = 0; i < Dirs.Num(); i++)
+		delete Dirs[i];
+	return true;
+
+	unguard;
+}
+
+static void RegisterGameFiles(const TArray<FString>& Files)
+{
+	guard(RegisterGameFiles);
+
+	// Mount all containers in parallel, reading of their directories is independent
+	TArray<int> VFSFiles;
+	for (int i = 0; i < Files.Num(); i++)
 	{
-		appSprintf(ARRAY_ARG(Path), "%s/%s", dir, *Filenames[i]);
-		appRegisterGameFile(Path);
+		if (IsVFSFile(*Files[i]))
+			VFSFiles.Add(i);
 	}
 
-	return res;
+	TArray<FVirtualFileSystem*> MountedVFS;
+	TArray<bool> DeferredVFS;
+	MountedVFS.AddZeroed(VFSFiles.Num());
+	DeferredVFS.AddZeroed(VFSFiles.Num());
+	ParallelFor(VFSFiles.Num(), [&](int i)
+		{
+			MountedVFS[i] = MountVFS(*Files[VFSFiles[i]], false, DeferredVFS[i]);
+		});
+
+	// Register files in the same order as they were found, so files from later containers will
+	// override previous ones (pak patches)
+	int VFSIndex = 0;
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		const char* FullName = *Files[i];
+		if (VFSIndex < VFSFiles.Num() && VFSFiles[VFSIndex] == i)
+		{
+			FVirtualFileSystem* vfs = MountedVFS[VFSIndex];
+			if (DeferredVFS[VFSIndex])
+			{
+				// Mount from the main thread, so user may be asked for AES key
+				bool bDeferred;
+				vfs = MountVFS(FullName, true, bDeferred);
+#if UNREAL4
+				if (GAesKey.Len())
+				{
+					// Got the key, mount the remaining containers which requires it
+					int First = VFSIndex + 1;
+					ParallelFor(VFSFiles.Num() - First, [&](int j)
+						{
+							if (DeferredVFS[First + j])
+								MountedVFS[First + j] = MountVFS(*Files[VFSFiles[First + j]], false, DeferredVFS[First + j]);
+						});
+				}
+#endif // UNREAL4
+			}
+			VFSIndex++;
+			if (!RegisterVFSFiles(FullName, vfs))
+				continue;
+		}
+		AddGameFile(FullName, NULL);
+	}
 
 	unguard;
 }
 
 
+/*-----------------------------------------------------------------------------
+	Persistent cache of pak file indices
+-----------------------------------------------------------------------------*/
+
+static char GCacheDirectory[MAX_PACKAGE_PATH];
+
+void appSetCacheDirectory(const char *dir)
+{
+	appStrncpyz(GCacheDirectory, dir, ARRAY_COUNT(GCacheDirectory));
+}
+
+const char *appGetCacheDirectory()
+{
+	return GCacheDirectory[0] ? GCacheDirectory : NULL;
+}
+
+const byte* appOpenCacheFile(const char *Filename, const void *Key, int KeySize, int HeaderSize, int CountsOffset,
+	int EntrySize, int ItemSize, FArchive *&Reader)
+{
+	guard(appOpenCacheFile);
+
+	Reader = NULL;
+	FArchive* Ar = new FFileReader(Filename, FAO_NoOpenError);
+	if (!Ar->IsOpen())
+	{
+		delete Ar;
+		return NULL;
+	}
+
+	int64 CacheSize = Ar->GetFileSize64();
+	const byte* Data = NULL;
+	if (CacheSize >= HeaderSize && CacheSize < (1LL << 31))
+		Data = Ar->BorrowData(0, (int)CacheSize);		// could fail if file is not memory-mapped
+	if (Data && memcmp(Data, Key, KeySize) == 0)
+	{
+		const int32* Counts = (const int32*)(Data + CountsOffset);
+		int32 NumEntries = Counts[0], NumItems = Counts[1], NamesSize = Counts[2];
+		// names block is the last one, so the file should end with null-terminated name
+		if (NumEntries >= 0 && NumItems >= 0 && NamesSize > 0 && Data[CacheSize - 1] == 0 &&
+			CacheSize == HeaderSize + (int64)NumEntries * EntrySize + (int64)NumItems * ItemSize + NamesSize)
+		{
+			Reader = Ar;
+			return Data;
+		}
+	}
+	delete Ar;
+	return NULL;
+
+	unguardf("%s", Filename);
+}
+
+#if UNREAL4
+
+#define PAK_CACHE_MAGIC			0x43495055		// 'UPIC'
+#define PAK_CACHE_VERSION		2
+
+// Cache file consists of FPakIndexCacheHeader followed by FPakIndexCacheEntry[NumEntries],
+// FPakCompressedBlock[NumBlocks] and NamesSize bytes of null-terminated file names. Structures
+// are stored in native format, so the file is used directly from memory-mapped FFileReader.
+struct FPakIndexCacheHeader
+{
+	uint32		Magic;
+	int32		CacheVersion;
+	// cache key
+	char		PakFilename[MAX_PACKAGE_PATH];	// absolute path
+	int64		PakSize;
+	int64		PakTime;
+	int32		PakVersion;
+	int64		IndexOffset;
+	int64		IndexSize;
+	byte		IndexHash[20];
+	uint32		KeyHash;						// AES key fingerprint, used for pak with encrypted index
+	// cached data
+	char		MountPoint[MAX_PACKAGE_PATH];
+	int32		NumEntries;
+	int32		NumBlocks;
+	int32		NamesSize;
+};
+
+struct FPakIndexCacheEntry
+{
+	int64		Pos;
+	int64		Size;
+	int64		UncompressedSize;
+	int32		CompressionMethod;
+	int32		CompressionBlockSize;
+	int32		StructSize;
+	int32		NameOffset;						// offset in names block
+	int32		FirstBlock;						// index in blocks array
+	int32		NumBlocks;
+	byte		bEncrypted;
+};
+
+// Fill the key part of cache header and compute cache file name. Returns false when cache can't be used.
+static bool MakePakCacheKey(const char* PakFilename, const FPakInfo& info, FPakIndexCacheHeader& Hdr, char* CacheFilename, int CacheFilenameSize)
+{
+	const char* CacheDir = appGetCacheDirectory();
+	if (!CacheDir) return false;
+
+	memset(&Hdr, 0, sizeof(Hdr));
+	Hdr.Magic = PAK_CACHE_MAGIC;
+	Hdr.CacheVersion = PAK_CACHE_VERSION;
+
+	// use absolute file name, so the same cache will be used regardless of current directory
+	if (!appGetFullPathName(PakFilename, ARRAY_ARG(Hdr.PakFilename))) return false;
+	if (!appGetFileSizeAndTime(Hdr.PakFilename, Hdr.PakSize, Hdr.PakTime)) return false;
+
+	Hdr.PakVersion = info.Version;
+	Hdr.IndexOffset = info.IndexOffset;
+	Hdr.IndexSize = info.IndexSize;
+	memcpy(Hdr.IndexHash, info.IndexHash, sizeof(Hdr.IndexHash));
+	// encrypted index will be decoded differently with another key; don't store the key itself
+	if (info.bEncryptedIndex)
+		Hdr.KeyHash = appStrhash(*GAesKey) | 1;
+
+	const char* ShortName = strrchr(Hdr.PakFilename, '/');
+	ShortName = ShortName ? ShortName + 1 : Hdr.PakFilename;
+	appSprintf(CacheFilename, CacheFilenameSize, "%s/PakIndex/%s-%08X.bin", CacheDir, ShortName, appStrhash(Hdr.PakFilename));
+	return true;
+}
+
+bool FPakVFS::LoadIndexCache(const FPakInfo& info)
+{
+	guard(FPakVFS::LoadIndexCache);
+
+	FPakIndexCacheHeader Key;
+	char CacheFilename[MAX_PACKAGE_PATH];
+	if (!MakePakCacheKey(*Filename, info, Key, ARRAY_ARG(CacheFilename)))
+		return false;
+
+	// everything before MountPoint is a key
+	FArchive* Ar;
+	const FPakIndexCacheHeader* Hdr = (const FPakIndexCacheHeader*)appOpenCacheFile(CacheFilename,
+		&Key, offsetof(FPakIndexCacheHeader, MountPoint), sizeof(FPakIndexCacheHeader), offsetof(FPakIndexCacheHeader, NumEntries),
+		sizeof(FPakIndexCacheEntry), sizeof(FPakCompressedBlock), Ar);
+	if (!Hdr) return false;
+	if (Hdr->MountPoint[ARRAY_COUNT(Hdr->MountPoint)-1] != 0)
+	{
+		delete Ar;
+		return false;
+	}
+
+	const FPakIndexCacheEntry* Entries = (const FPakIndexCacheEntry*)(Hdr + 1);
+	const FPakCompressedBlock* Blocks = (const FPakCompressedBlock*)(Entries + Hdr->NumEntries);
+	const char* Names = (const char*)(Blocks + Hdr->NumBlocks);
+
+	FileInfos.AddZeroed(Hdr->NumEntries);
+	for (int i = 0; i < Hdr->NumEntries; i++)
+	{
+		const FPakIndexCacheEntry& C = Entries[i];
+		if (C.NameOffset < 0 || C.NameOffset >= Hdr->NamesSize || C.FirstBlock < 0 || C.NumBlocks < 0 ||
+			C.FirstBlock + C.NumBlocks > Hdr->NumBlocks)
+		{
+			FileInfos.Empty();
+			delete Ar;
+			return false;
+		}
+		FPakEntry& E = FileInfos[i];
+		E.Name = Names + C.NameOffset;		// points to memory-mapped file
+		E.Pos = C.Pos;
+		E.Size = C.Size;
+		E.UncompressedSize = C.UncompressedSize;
+		E.CompressionMethod = C.CompressionMethod;
+		E.CompressionBlockSize = C.CompressionBlockSize;
+		E.StructSize = C.StructSize;
+		E.bEncrypted = C.bEncrypted;
+		E.FirstBlock = C.FirstBlock;
+		E.NumBlocks = C.NumBlocks;
+	}
+	// block pool has the same layout as in the cache
+	if (Hdr->NumBlocks)
+	{
+		CompressionBlocks.AddUninitialized(Hdr->NumBlocks);
+		memcpy(CompressionBlocks.GetData(), Blocks, Hdr->NumBlocks * sizeof(FPakCompressedBlock));
+	}
+
+	MountPoint = Hdr->MountPoint;
+	CacheReader = Ar;			// keep the file mapped, it holds file names
+	BuildHash();
+	return true;
+
+	unguardf("%s", *Filename);
+}
+
+void FPakVFS::SaveIndexCache(const FPakInfo& info)
+{
+	guard(FPakVFS::SaveIndexCache);
+
+	FPakIndexCacheHeader Hdr;
+	char CacheFilename[MAX_PACKAGE_PATH];
+	if (!MakePakCacheKey(*Filename, info, Hdr, ARRAY_ARG(CacheFilename)))
+		return;
+	appStrncpyz(Hdr.MountPoint, *MountPoint, ARRAY_COUNT(Hdr.MountPoint));
+
+	// convert index to flat arrays, compression blocks are already stored in this format
+	TArray<FPakIndexCacheEntry> Entries;
+	TArray<char> Names;
+	Entries.AddZeroed(FileInfos.Num());
+	for (int i = 0; i < FileInfos.Num(); i++)
+	{
+		const FPakEntry& E = FileInfos[i];
+		FPakIndexCacheEntry& C = Entries[i];
+		C.Pos = E.Pos;
+		C.Size = E.Size;
+		C.UncompressedSize = E.UncompressedSize;
+		C.CompressionMethod = E.CompressionMethod;
+		C.CompressionBlockSize = E.CompressionBlockSize;
+		C.StructSize = E.StructSize;
+		C.bEncrypted = E.bEncrypted;
+		C.FirstBlock = E.FirstBlock;
+		C.NumBlocks = E.NumBlocks;
+		// name
+		int NameLen = strlen(E.Name) + 1;
+		C.NameOffset = Names.AddUninitialized(NameLen);
+		memcpy(&Names[C.NameOffset], E.Name, NameLen);
+	}
+	Names.Add(0);				// names block is never empty
+	Hdr.NumEntries = Entries.Num();
+	Hdr.NumBlocks = CompressionBlocks.Num();
+	Hdr.NamesSize = Names.Num();
+
+	// write to a temporary file and then rename it, so partially written cache will never be used
+	char TempFilename[MAX_PACKAGE_PATH];
+	appSprintf(ARRAY_ARG(TempFilename), "%s.tmp", CacheFilename);
+	appMakeDirectoryForFile(TempFilename);
+	FArchive* Ar = new FFileWriter(TempFilename, FAO_NoOpenError);
+	if (!Ar->IsOpen())
+	{
+		delete Ar;
+		return;
+	}
+	Ar->Serialize(&Hdr, sizeof(Hdr));
+	if (Entries.Num()) Ar->Serialize(Entries.GetData(), Entries.Num() * sizeof(FPakIndexCacheEntry));
+	if (CompressionBlocks.Num()) Ar->Serialize(CompressionBlocks.GetData(), CompressionBlocks.Num() * sizeof(FPakCompressedBlock));
+	Ar->Serialize(Names.GetData(), Names.Num());
+	delete Ar;
+
+	remove(CacheFilename);		// rename() fails on Windows when destination exists
+	rename(TempFilename, CacheFilename);
+
+	unguardf("%s", *Filename);
+}
+
+
+/*-----------------------------------------------------------------------------
+	Cache of decompressed pak blocks
+-----------------------------------------------------------------------------*/
+
+#define PAK_BLOCK_CACHE_SIZE		(64 << 20)		// limit for total size of cached blocks, in bytes
+#define PAK_BLOCK_HASH_SIZE			4096
+
+static CMutex     PakBlockLock;
+static FPakBlock* PakBlockHash[PAK_BLOCK_HASH_SIZE];
+static FPakBlock* PakBlockLruFirst = NULL;			// most recently used block
+static FPakBlock* PakBlockLruLast = NULL;
+static int        PakBlockCacheSize = 0;
+
+static int GetPakBlockHash(const FArchive* Reader, int64 EntryPos, int BlockIndex)
+{
+	uint32 hash = (uint32)(size_t)Reader ^ (uint32)EntryPos ^ (uint32)(EntryPos >> 32);
+	hash = hash * 0x9E3779B1 + BlockIndex;
+	return (hash ^ (hash >> 16)) & (PAK_BLOCK_HASH_SIZE - 1);
+}
+
+static void PakBlockUnlinkLru(FPakBlock* Block)
+{
+	if (Block->LruPrev) Block->LruPrev->LruNext = Block->LruNext; else PakBlockLruFirst = Block->LruNext;
+	if (Block->LruNext) Block->LruNext->LruPrev = Block->LruPrev; else PakBlockLruLast = Block->LruPrev;
+	Block->LruPrev = Block->LruNext = NULL;
+}
+
+static void PakBlockLinkLru(FPakBlock* Block)
+{
+	Block->LruPrev = NULL;
+	Block->LruNext = PakBlockLruFirst;
+	if (PakBlockLruFirst) PakBlockLruFirst->LruPrev = Block; else PakBlockLruLast = Block;
+	PakBlockLruFirst = Block;
+}
+
+// Remove least recently used blocks which are not locked. Called with locked PakBlockLock.
+static void PakBlockTrimCache()
+{
+	FPakBlock* Block = PakBlockLruLast;
+	while (PakBlockCacheSize > PAK_BLOCK_CACHE_SIZE && Block)
+	{
+		FPakBlock* Prev = Block->LruPrev;
+		if (Block->RefCount == 0)
+		{
+			// remove from hash
+			FPakBlock** Link = &PakBlockHash[GetPakBlockHash(Block->Reader, Block->EntryPos, Block->BlockIndex)];
+			while (*Link != Block) Link = &(*Link)->HashNext;
+			*Link = Block->HashNext;
+			PakBlockUnlinkLru(Block);
+			PakBlockCacheSize -= Block->Size;
+			appFree(Block->Data);
+			delete Block;
+		}
+		Block = Prev;
+	}
+}
+
+FPakBlock* PakFindBlock(const FArchive* Reader, int64 EntryPos, int BlockIndex)
+{
+	TScopeLock<CMutex> Lock(PakBlockLock);
+	for (FPakBlock* Block = PakBlockHash[GetPakBlockHash(Reader, EntryPos, BlockIndex)]; Block; Block = Block->HashNext)
+	{
+		if (Block->Reader == Reader && Block->EntryPos == EntryPos && Block->BlockIndex == BlockIndex)
+		{
+			Block->RefCount++;
+			// move to the head of LRU list
+			PakBlockUnlinkLru(Block);
+			PakBlockLinkLru(Block);
+#if PROFILE
+			appInterlockedIncrement(&GNumPakBlockHits);
+#endif
+			return Block;
+		}
+	}
+#if PROFILE
+	appInterlockedIncrement(&GNumPakBlockMisses);
+#endif
+	return NULL;
+}
+
+FPakBlock* PakAddBlock(const FArchive* Reader, int64 EntryPos, int BlockIndex, byte* Data, int Size)
+{
+	TScopeLock<CMutex> Lock(PakBlockLock);
+	int hash = GetPakBlockHash(Reader, EntryPos, BlockIndex);
+	for (FPakBlock* Block = PakBlockHash[hash]; Block; Block = Block->HashNext)
+	{
+		if (Block->Reader == Reader && Block->EntryPos == EntryPos && Block->BlockIndex == BlockIndex)
+		{
+			// the same block was decompressed by another thread
+			appFree(Data);
+			Block->RefCount++;
+			return Block;
+		}
+	}
+
+	FPakBlock* Block = new FPakBlock;
+	Block->Reader = Reader;
+	Block->EntryPos = EntryPos;
+	Block->BlockIndex = BlockIndex;
+	Block->Data = Data;
+	Block->Size = Size;
+	Block->RefCount = 1;
+	Block->HashNext = PakBlockHash[hash];
+	PakBlockHash[hash] = Block;
+	PakBlockLinkLru(Block);
+	PakBlockCacheSize += Size;
+	PakBlockTrimCache();
+	return Block;
+}
+
+void PakReleaseBlock(FPakBlock* Block)
+{
+	TScopeLock<CMutex> Lock(PakBlockLock);
+	assert(Block->RefCount > 0);
+	Block->RefCount--;
+	if (Block->RefCount == 0 && PakBlockCacheSize > PAK_BLOCK_CACHE_SIZE)
+		PakBlockTrimCache();
+}
+
+#endif // UNREAL4
+
+
 void LoadGears4Manifest(const CGameFileInfo* info);
 
 void appSetRootDirectory(const char *dir, bool recurse)
@@ -476,7 +1267,9 @@ void appSetRootDirectory(const char *dir, bool recurse)
 	guard(appSetRootDirectory);
 	if (dir[0] == 0) dir = ".";	// using dir="" will cause scanning of "/dir1", "/dir2" etc (i.e. drive root)
 	appStrncpyz(GRootDirectory, dir, ARRAY_COUNT(GRootDirectory));
-	ScanGameDirectory(GRootDirectory, recurse);
+	TArray<FString> Files;
+	ScanGameDirectory(GRootDirectory, recurse, Files);
+	RegisterGameFiles(Files);
 
 #if GEARS4
 	if (GForceGame == GAME_Gears4)
@@ -525,6 +1318,9 @@ void appSetRootDirectory(const char *dir, bool recurse)
 
 #if PRINT_HASH_DISTRIBUTION
 	PrintHashDistribution();
+#endif
+#if PROFILE_FILE_LOOKUP
+	ProfileFileLookup();
 #endif
 	unguardf("dir=%s", dir);
 }
@@ -666,12 +1462,8 @@ const CGameFileInfo *appFindGameFile(const char *Filename, const char *Ext)
 		if (*s == '/') ShortFilename = s + 1;
 	}
 
-	// Get hash before stripping extension (could be required for files with double extension, like .hdr.rtc for games with Redux textures)
-	int hash = GetHashForFileName(buf, /* stripExtension = */ Ext == NULL);
-#if DEBUG_HASH
-	printf("--> find(%s) hash=%X\n", buf, hash);
-#endif
-
+	// Note: when extension is provided, filename could contain a dot (could be required for files with double
+	// extension, like .hdr.rtc for games with Redux textures)
 	if (Ext)
 	{
 		// extension is provided
@@ -689,27 +1481,26 @@ const CGameFileInfo *appFindGameFile(const char *Filename, const char *Ext)
 	}
 
 	int nameLen = strlen(ShortFilename);
+	uint32 hash = GetHashForFileName(ShortFilename, nameLen);
 #if defined(DEBUG_HASH_NAME) || DEBUG_HASH
 	printf("--> Loading %s (%s, len=%d, hash=%X)\n", buf, ShortFilename, nameLen, hash);
 #endif
 
+	// all files in the slot have the same short filename
+	const CGameFileHashSlot* slot = FindGameFileSlot(ShortFilename, nameLen, hash);
+	if (!slot) return NULL;
+
 	CGameFileInfo* bestMatch = NULL;
 	int bestMatchWeight = -1;
-	for (CGameFileInfo* info = GGameFileHash[hash]; info; info = info->HashNext)
+	for (CGameFileInfo* info = slot->Files; info; info = info->HashNext)
 	{
 #if defined(DEBUG_HASH_NAME) || DEBUG_HASH
 		printf("----> verify %s\n", info->RelativeName);
 #endif
-		if (info->Extension - 1 - info->ShortFilename != nameLen)	// info->Extension points to char after '.'
-		{
-//			printf("-----> wrong length %d\n", info->Extension - info->ShortFilename);
-			continue;		// different filename length
-		}
-
 		// verify extension
 		if (Ext)
 		{
-			if (stricmp(info->Extension, Ext) != 0) continue;
+			if (!info->Extension || stricmp(info->Extension, Ext) != 0) continue;
 		}
 		else
 		{
@@ -717,12 +1508,6 @@ const CGameFileInfo *appFindGameFile(const char *Filename, const char *Ext)
 			if (!info->IsPackage) continue;
 		}
 
-		// verify a filename
-		if (strnicmp(info->ShortFilename, ShortFilename, nameLen) != 0)
-			continue;
-//		if (info->ShortFilename[nameLen] != '.') -- verified before extension comparison
-//			continue;
-
 		// Short filename matched, now compare path before the filename.
 		// Assume 'ShortFilename' is part of 'buf' and 'info->ShortFilename' is part of 'info->RelativeName'.
 		int matchWeight = 0;
@@ -816,7 +1601,25 @@ void appFindGameFiles(const char *Filename, TArray<const CGameFileInfo*>& Files)
 	FindPackageWildcardData findData;
 	findData.WildcardContainsPath = containsPath;
 	findData.Wildcard = buf;
-	appEnumGameFiles(FindPackageWildcardCallback, findData);
+
+	if (containsPath && !strchr(buf, ','))
+	{
+		// all matching files are located inside the directory which is specified before the first
+		// wildcard character, so check only this directory tree
+		int prefixLen = strcspn(buf, "*?");
+		while (prefixLen > 0 && buf[prefixLen] != '/')
+			prefixLen--;
+		char dir[MAX_PACKAGE_PATH];
+		appStrncpyz(dir, buf, prefixLen + 1);
+		TArray<const CGameFileInfo*> Candidates;
+		appGetGameFolderFiles(dir, Candidates, true);
+		for (int i = 0; i < Candidates.Num(); i++)
+			FindPackageWildcardCallback(Candidates[i], findData);
+	}
+	else
+	{
+		appEnumGameFiles(FindPackageWildcardCallback, findData);
+	}
 
 	CopyArray(Files, findData.FoundFiles);
 
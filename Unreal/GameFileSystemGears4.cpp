@@ -156,8 +156,7 @@ public:
 		if (ArStopper > 0 && ArPos + size > ArStopper)
 			appError("Serializing behind stopper (%X+%X > %X)", ArPos, size, ArStopper);
 
-		Reader->Seek64(Info->Position + ArPos);
-		Reader->Serialize(data, size);
+		Reader->ReadAt(Info->Position + ArPos, data, size);
 		ArPos += size;
 
 		unguard;
@@ -295,8 +294,9 @@ protected:
 
 	const FGears4BundledInfo* FindFile(const char* name)
 	{
-		if (LastInfo && !stricmp(LastInfo->Name, name))
-			return LastInfo;
+		FGears4BundledInfo* Last = LastInfo;				// read once, could be changed by another thread
+		if (Last && !stricmp(Last->Name, name))
+			return Last;
 
 		if (HashTable)
 		{
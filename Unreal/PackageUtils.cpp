@@ -5,6 +5,7 @@
 #include "UnPackage.h"
 
 #include "PackageUtils.h"
+#include "Parallel.h"
 
 /*-----------------------------------------------------------------------------
 	Package loader/unloader
@@ -76,35 +77,340 @@ void ReleaseAllObjects()
 
 
 /*-----------------------------------------------------------------------------
-	Package version scanner
+	Persistent cache of package information
 -----------------------------------------------------------------------------*/
 
-struct ScanPackageData
+// Results of ScanPackageVersions() and ScanContent() are saved to the cache directory, so the next
+// scan of the same game will open only new or modified packages. Cached information is identified
+// by relative file name, size and modification time.
+
+#define PACKAGE_CACHE_MAGIC			0x49505055		// 'UPPI'
+#define PACKAGE_CACHE_VERSION		1
+
+#define PACKAGE_VER_UNKNOWN			-1				// version wasn't scanned
+#define PACKAGE_VER_NOT_PACKAGE		-2				// file has no package tag
+
+// Cache file consists of FPackageCacheHeader followed by FPackageCacheEntry[NumEntries],
+// FPackageCacheClass[NumClasses] and NamesSize bytes of null-terminated strings.
+struct FPackageCacheHeader
+{
+	uint32		Magic;
+	int32		CacheVersion;
+	// cache key
+	char		RootDirectory[MAX_PACKAGE_PATH];	// absolute path
+	int32		Game;							// GForceGame
+	int32		Platform;						// GForcePlatform
+	// cached data
+	int32		NumEntries;
+	int32		NumClasses;
+	int32		NamesSize;
+};
+
+struct FPackageCacheEntry
+{
+	int64		Size;
+	int64		Time;
+	int32		NameOffset;						// offset in names block
+	int32		Ver;							// or PACKAGE_VER_... constant
+	int32		LicVer;
+	int32		FirstClass;						// index in classes array
+	int32		NumClasses;						// -1 when content wasn't scanned
+};
+
+struct FPackageCacheClass
+{
+	int32		NameOffset;
+	int32		Count;
+};
+
+struct CPackageCacheItem
 {
-	ScanPackageData()
-	:	Progress(NULL)
-	,	Cancelled(false)
-	,	Index(0)
-	{}
-
-	TArray<FileInfo>*	PkgInfo;
-	IProgressCallback*	Progress;
-	bool				Cancelled;
-	int					Index;
+	const char*			Name;					// relative file name, pooled string
+	int64				Size;
+	int64				Time;
+	int					Ver;
+	int					LicVer;
+	bool				bHasContent;
+	TArray<ClassStats>	Classes;				// export class histogram, names are pooled strings
+	CPackageCacheItem*	HashNext;
 };
 
-static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
+static char               GPackageCacheFilename[MAX_PACKAGE_PATH];
+static FPackageCacheHeader GPackageCacheKey;
+static bool               GPackageCacheLoaded = false;
+static bool               GPackageCacheDirty = false;
+static TArray<CPackageCacheItem*> GPackageCache;
+static CPackageCacheItem** GPackageCacheHash = NULL;
+static int                GPackageCacheHashSize = 0;		// power of 2
+
+// Fill the key part of cache header and compute cache file name. Returns false when cache can't be used.
+static bool MakePackageCacheKey(FPackageCacheHeader& Hdr, char* CacheFilename, int CacheFilenameSize)
 {
-	guard(ScanPackage);
+	const char* CacheDir = appGetCacheDirectory();
+	const char* RootDir = appGetRootDirectory();
+	if (!CacheDir || !RootDir) return false;
+
+	memset(&Hdr, 0, sizeof(Hdr));
+	Hdr.Magic = PACKAGE_CACHE_MAGIC;
+	Hdr.CacheVersion = PACKAGE_CACHE_VERSION;
+	if (!appGetFullPathName(RootDir, ARRAY_ARG(Hdr.RootDirectory))) return false;
+	// package parsing depends on game and platform overrides
+	Hdr.Game = GForceGame;
+	Hdr.Platform = GForcePlatform;
+
+	const char* ShortName = strrchr(Hdr.RootDirectory, '/');
+	ShortName = ShortName ? ShortName + 1 : Hdr.RootDirectory;
+	appSprintf(CacheFilename, CacheFilenameSize, "%s/PackageInfo/%s-%08X.bin", CacheDir, ShortName,
+		appStrhash(Hdr.RootDirectory) ^ (Hdr.Game * 0x9E3779B1) ^ Hdr.Platform);
+	return true;
+}
 
-	if (data.Progress)
+static void AddPackageCacheItem(CPackageCacheItem* Item)
+{
+	if (GPackageCache.Num() >= GPackageCacheHashSize)
 	{
-		if (!data.Progress->Progress(file->RelativeName, data.Index++, GNumPackageFiles))
+		// grow the hash, keep load factor below 1
+		if (GPackageCacheHash) appFree(GPackageCacheHash);
+		GPackageCacheHashSize = max(GPackageCacheHashSize * 2, 4096);
+		GPackageCacheHash = (CPackageCacheItem**)appMalloc(GPackageCacheHashSize * sizeof(CPackageCacheItem*));
+		for (int i = 0; i < GPackageCache.Num(); i++)
 		{
-			data.Cancelled = true;
-			return false;
+			CPackageCacheItem* Other = GPackageCache[i];
+			int index = appGetPoolStringHash(Other->Name) & (GPackageCacheHashSize - 1);
+			Other->HashNext = GPackageCacheHash[index];
+			GPackageCacheHash[index] = Other;
 		}
 	}
+	GPackageCache.Add(Item);
+	int index = appGetPoolStringHash(Item->Name) & (GPackageCacheHashSize - 1);
+	Item->HashNext = GPackageCacheHash[index];
+	GPackageCacheHash[index] = Item;
+}
+
+static void ReleasePackageCache()
+{
+	for (int i = 0; i < GPackageCache.Num(); i++)
+		delete GPackageCache[i];
+	GPackageCache.Empty();
+	if (GPackageCacheHash) appFree(GPackageCacheHash);
+	GPackageCacheHash = NULL;
+	GPackageCacheHashSize = 0;
+}
+
+static void LoadPackageCache()
+{
+	guard(LoadPackageCache);
+
+	GPackageCacheLoaded = true;
+	if (!MakePackageCacheKey(GPackageCacheKey, ARRAY_ARG(GPackageCacheFilename)))
+	{
+		GPackageCacheFilename[0] = 0;		// disable cache
+		return;
+	}
+
+	// everything before NumEntries is a key
+	FArchive* Ar;
+	const FPackageCacheHeader* Hdr = (const FPackageCacheHeader*)appOpenCacheFile(GPackageCacheFilename,
+		&GPackageCacheKey, offsetof(FPackageCacheHeader, NumEntries), sizeof(FPackageCacheHeader), offsetof(FPackageCacheHeader, NumEntries),
+		sizeof(FPackageCacheEntry), sizeof(FPackageCacheClass), Ar);
+	if (!Hdr) return;
+
+	const FPackageCacheEntry* Entries = (const FPackageCacheEntry*)(Hdr + 1);
+	const FPackageCacheClass* Classes = (const FPackageCacheClass*)(Entries + Hdr->NumEntries);
+	const char* Names = (const char*)(Classes + Hdr->NumClasses);
+
+	for (int i = 0; i < Hdr->NumEntries; i++)
+	{
+		const FPackageCacheEntry& E = Entries[i];
+		bool Valid = (E.NameOffset >= 0 && E.NameOffset < Hdr->NamesSize && E.FirstClass >= 0 &&
+			E.FirstClass + max(E.NumClasses, 0) <= Hdr->NumClasses);
+		for (int j = 0; Valid && j < E.NumClasses; j++)
+		{
+			int NameOffset = Classes[E.FirstClass + j].NameOffset;
+			Valid = (NameOffset >= 0 && NameOffset < Hdr->NamesSize);
+		}
+		if (!Valid)
+		{
+			ReleasePackageCache();
+			break;
+		}
+		CPackageCacheItem* Item = new CPackageCacheItem;
+		Item->Name = appStrdupPool(Names + E.NameOffset);
+		Item->Size = E.Size;
+		Item->Time = E.Time;
+		Item->Ver = E.Ver;
+		Item->LicVer = E.LicVer;
+		Item->bHasContent = (E.NumClasses >= 0);
+		if (E.NumClasses > 0)
+		{
+			Item->Classes.AddUninitialized(E.NumClasses);
+			for (int j = 0; j < E.NumClasses; j++)
+			{
+				const FPackageCacheClass& C = Classes[E.FirstClass + j];
+				Item->Classes[j].Name = appStrdupPool(Names + C.NameOffset);
+				Item->Classes[j].Count = C.Count;
+			}
+		}
+		AddPackageCacheItem(Item);
+	}
+
+	delete Ar;
+
+	unguardf("%s", GPackageCacheFilename);
+}
+
+static void SavePackageCache()
+{
+	guard(SavePackageCache);
+
+	if (!GPackageCacheDirty || !GPackageCacheFilename[0]) return;
+	GPackageCacheDirty = false;
+
+	FPackageCacheHeader Hdr = GPackageCacheKey;
+	TArray<FPackageCacheEntry> Entries;
+	TArray<FPackageCacheClass> Classes;
+	TArray<char> Names;
+	Entries.AddZeroed(GPackageCache.Num());
+
+	// Class names are shared between packages, store each one once. ClassNameHash is indexed
+	// with pooled string hash and holds indices in UniqueClasses.
+	TArray<const char*> UniqueClasses;
+	TArray<int> UniqueClassOffsets;
+	TArray<int> UniqueClassNext;
+	int ClassNameHash[1024];
+	memset(ClassNameHash, 0xFF, sizeof(ClassNameHash));		// fill with INDEX_NONE
+
+	for (int i = 0; i < GPackageCache.Num(); i++)
+	{
+		const CPackageCacheItem* Item = GPackageCache[i];
+		FPackageCacheEntry& E = Entries[i];
+		E.Size = Item->Size;
+		E.Time = Item->Time;
+		E.Ver = Item->Ver;
+		E.LicVer = Item->LicVer;
+		E.FirstClass = Classes.Num();
+		E.NumClasses = Item->bHasContent ? Item->Classes.Num() : -1;
+		// name
+		int NameLen = strlen(Item->Name) + 1;
+		E.NameOffset = Names.AddUninitialized(NameLen);
+		memcpy(&Names[E.NameOffset], Item->Name, NameLen);
+		// classes
+		for (int j = 0; j < Item->Classes.Num(); j++)
+		{
+			const char* ClassName = Item->Classes[j].Name;
+			int index = appGetPoolStringHash(ClassName) & (ARRAY_COUNT(ClassNameHash) - 1);
+			int Unique;
+			for (Unique = ClassNameHash[index]; Unique != INDEX_NONE; Unique = UniqueClassNext[Unique])
+			{
+				if (UniqueClasses[Unique] == ClassName) break;
+			}
+			if (Unique == INDEX_NONE)
+			{
+				Unique = UniqueClasses.Add(ClassName);
+				UniqueClassNext.Add(ClassNameHash[index]);
+				ClassNameHash[index] = Unique;
+				int ClassNameLen = strlen(ClassName) + 1;
+				int Offset = Names.AddUninitialized(ClassNameLen);
+				memcpy(&Names[Offset], ClassName, ClassNameLen);
+				UniqueClassOffsets.Add(Offset);
+			}
+			FPackageCacheClass* C = new (Classes) FPackageCacheClass;
+			C->NameOffset = UniqueClassOffsets[Unique];
+			C->Count = Item->Classes[j].Count;
+		}
+	}
+	Names.Add(0);				// names block is never empty
+	Hdr.NumEntries = Entries.Num();
+	Hdr.NumClasses = Classes.Num();
+	Hdr.NamesSize = Names.Num();
+
+	// write to a temporary file and then rename it, so partially written cache will never be used
+	char TempFilename[MAX_PACKAGE_PATH];
+	appSprintf(ARRAY_ARG(TempFilename), "%s.tmp", GPackageCacheFilename);
+	appMakeDirectoryForFile(TempFilename);
+	FArchive* Ar = new FFileWriter(TempFilename, FAO_NoOpenError);
+	if (!Ar->IsOpen())
+	{
+		delete Ar;
+		return;
+	}
+	Ar->Serialize(&Hdr, sizeof(Hdr));
+	if (Entries.Num()) Ar->Serialize(Entries.GetData(), Entries.Num() * sizeof(FPackageCacheEntry));
+	if (Classes.Num()) Ar->Serialize(Classes.GetData(), Classes.Num() * sizeof(FPackageCacheClass));
+	Ar->Serialize(Names.GetData(), Names.Num());
+	delete Ar;
+
+	remove(GPackageCacheFilename);		// rename() fails on Windows when destination exists
+	rename(TempFilename, GPackageCacheFilename);
+
+	unguardf("%s", GPackageCacheFilename);
+}
+
+// Get cache item for the file. Outdated information is dropped, and a new item is created when
+// file is not in cache yet. Returns NULL when caching is disabled.
+static CPackageCacheItem* GetPackageCacheItem(const CGameFileInfo* file)
+{
+	if (!GPackageCacheLoaded) LoadPackageCache();
+	if (!GPackageCacheFilename[0]) return NULL;
+	if (!file->Time) return NULL;			// modification time is unknown, cached data couldn't be validated
+
+	CPackageCacheItem* Item;
+	for (Item = GPackageCacheHash ? GPackageCacheHash[appGetPoolStringHash(file->RelativeName) & (GPackageCacheHashSize - 1)] : NULL;
+		Item; Item = Item->HashNext)
+	{
+		if (Item->Name == file->RelativeName) break;	// both strings are pooled
+	}
+
+	if (!Item)
+	{
+		Item = new CPackageCacheItem;
+		Item->Name = file->RelativeName;
+		Item->Ver = PACKAGE_VER_UNKNOWN;
+		Item->Size = file->Size;
+		Item->Time = file->Time;
+		AddPackageCacheItem(Item);
+	}
+	else if (Item->Size != file->Size || Item->Time != file->Time)
+	{
+		// file was modified
+		Item->Size = file->Size;
+		Item->Time = file->Time;
+		Item->Ver = PACKAGE_VER_UNKNOWN;
+		Item->bHasContent = false;
+		Item->Classes.Empty();
+		GPackageCacheDirty = true;
+	}
+	return Item;
+}
+
+
+/*-----------------------------------------------------------------------------
+	Package version scanner
+-----------------------------------------------------------------------------*/
+
+// Number of packages processed by worker threads between progress updates
+#define SCAN_BATCH_SIZE		256
+
+struct ScanVersionResult
+{
+	CPackageCacheItem*	Cached;
+	bool				Valid;				// false when file wasn't scanned yet
+	bool				IsPackage;
+	int					Ver;
+	int					LicVer;
+};
+
+static bool CollectGameFile(const CGameFileInfo *file, TArray<const CGameFileInfo*> &Files)
+{
+	Files.Add(file);
+	return true;
+}
+
+// Read package version from the file header. Returns false if file is not a package.
+// Could be called from a worker thread.
+static bool ReadPackageVersion(const CGameFileInfo *file, int &Ver, int &LicVer)
+{
+	guard(ReadPackageVersion);
 
 	// read a few first bytes as integers
 	FArchive *Ar = appCreateFileReader(file);
@@ -123,33 +429,40 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		//!! Use CreatePackageLoader() here to allow scanning of packages with custom header (Lineage etc);
 		//!! do that only when something "strange" within data noticed.
 		//!! Also, this function could react on custom package tags.
-		return true;
+		return false;
 	}
 	uint32 Version = FileData[1];
 
-	FileInfo Info;
-
 #if UNREAL4
 	if ((Version & 0xFFFFF000) == 0xFFFFF000)
 	{
 		// next fields are: int VersionUE3, Version, LicenseeVersion
-		Info.Ver    = FileData[3];
-		Info.LicVer = FileData[4];
+		Ver    = FileData[3];
+		LicVer = FileData[4];
 	}
 	else
 #endif // UNREAL4
 	{
-		Info.Ver    = Version & 0xFFFF;
-		Info.LicVer = Version >> 16;
+		Ver    = Version & 0xFFFF;
+		LicVer = Version >> 16;
 	}
+	return true;
 
+	unguardf("%s", file->RelativeName);
+}
+
+static void AddPackageVersion(TArray<FileInfo>& PkgInfo, const char* FileName, int Ver, int LicVer)
+{
+	FileInfo Info;
+	Info.Ver    = Ver;
+	Info.LicVer = LicVer;
 	Info.Count  = 0;
-	strcpy(Info.FileName, file->RelativeName);
-//	printf("%s - %d/%d\n", file->RelativeName, Info.Ver, Info.LicVer);
+	strcpy(Info.FileName, FileName);
+//	printf("%s - %d/%d\n", FileName, Info.Ver, Info.LicVer);
 	int Index = INDEX_NONE;
-	for (int i = 0; i < data.PkgInfo->Num(); i++)
+	for (int i = 0; i < PkgInfo.Num(); i++)
 	{
-		FileInfo &Info2 = (*data.PkgInfo)[i];
+		FileInfo &Info2 = PkgInfo[i];
 		if (Info2.Ver == Info.Ver && Info2.LicVer == Info.LicVer)
 		{
 			Index = i;
@@ -157,9 +470,9 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		}
 	}
 	if (Index == INDEX_NONE)
-		Index = data.PkgInfo->Add(Info);
+		Index = PkgInfo.Add(Info);
 	// update info
-	FileInfo& fileInfo = (*data.PkgInfo)[Index];
+	FileInfo& fileInfo = PkgInfo[Index];
 	fileInfo.Count++;
 	// combine filename
 	char *s = fileInfo.FileName;
@@ -170,20 +483,68 @@ static bool ScanPackage(const CGameFileInfo *file, ScanPackageData &data)
 		d++;
 	}
 	*s = 0;
-
-	return true;
-
-	unguardf("%s", file->RelativeName);
 }
 
 
 bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 {
+	guard(ScanPackageVersions);
+
 	info.Empty();
-	ScanPackageData data;
-	data.PkgInfo = &info;
-	data.Progress = progress;
-	appEnumGameFiles(ScanPackage, data);
+	TArray<const CGameFileInfo*> Files;
+	appEnumGameFiles(CollectGameFile, Files);
+
+	// Files are processed in batches: progress and cache are handled in this thread, and file headers
+	// are read by worker threads. Results are merged in the original order.
+	bool Cancelled = false;
+	TArray<ScanVersionResult> Results;
+	for (int First = 0; First < Files.Num() && !Cancelled; First += SCAN_BATCH_SIZE)
+	{
+		int Count = min(SCAN_BATCH_SIZE, Files.Num() - First);
+		Results.Empty(Count);
+		Results.AddZeroed(Count);
+		for (int i = 0; i < Count; i++)
+		{
+			const CGameFileInfo* file = Files[First + i];
+			if (progress && !progress->Progress(file->RelativeName, First + i, Files.Num()))
+			{
+				Cancelled = true;
+				Count = i;
+				break;
+			}
+			ScanVersionResult& R = Results[i];
+			R.Cached = GetPackageCacheItem(file);
+			if (R.Cached && R.Cached->Ver != PACKAGE_VER_UNKNOWN)
+			{
+				R.Valid     = true;
+				R.IsPackage = (R.Cached->Ver != PACKAGE_VER_NOT_PACKAGE);
+				R.Ver       = R.Cached->Ver;
+				R.LicVer    = R.Cached->LicVer;
+			}
+		}
+
+		ParallelFor(Count, [&](int i)
+			{
+				ScanVersionResult& R = Results[i];
+				if (!R.Valid)
+					R.IsPackage = ReadPackageVersion(Files[First + i], R.Ver, R.LicVer);
+			});
+
+		for (int i = 0; i < Count; i++)
+		{
+			const ScanVersionResult& R = Results[i];
+			if (!R.Valid && R.Cached)
+			{
+				R.Cached->Ver    = R.IsPackage ? R.Ver : PACKAGE_VER_NOT_PACKAGE;
+				R.Cached->LicVer = R.IsPackage ? R.LicVer : 0;
+				GPackageCacheDirty = true;
+			}
+			if (R.IsPackage)
+				AddPackageVersion(info, Files[First + i]->RelativeName, R.Ver, R.LicVer);
+		}
+	}
+
+	SavePackageCache();
 	info.Sort([](const FileInfo& p1, const FileInfo& p2) -> int
 		{
 			int dif = p1.Ver - p2.Ver;
@@ -191,7 +552,9 @@ bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 			return p1.LicVer - p2.LicVer;
 		});
 
-	return !data.Cancelled;
+	return !Cancelled;
+
+	unguard;
 }
 
 
@@ -199,20 +562,50 @@ bool ScanPackageVersions(TArray<FileInfo>& info, IProgressCallback* progress)
 	Package content
 -----------------------------------------------------------------------------*/
 
-static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
+static int* GetClassCounter(CGameFileInfo* file, const char* ObjectClass)
+{
+	if (!stricmp(ObjectClass, "SkeletalMesh") || !stricmp(ObjectClass, "DestructibleMesh"))
+		return &file->NumSkeletalMeshes;
+	else if (!stricmp(ObjectClass, "StaticMesh"))
+		return &file->NumStaticMeshes;
+	else if (!stricmp(ObjectClass, "Animation") || !stricmp(ObjectClass, "MeshAnimation") || !stricmp(ObjectClass, "AnimSequence")) // whole AnimSet count for UE2 and number of sequences for UE3+
+		return &file->NumAnimations;
+	else if (!strnicmp(ObjectClass, "Texture", 7))
+		return &file->NumTextures;
+	return NULL;
+}
+
+// Build a histogram of export classes. Class names are pooled strings.
+static void ScanPackageExports(UnPackage* package, TArray<ClassStats>& Classes)
 {
+	guard(ScanPackageExports);
+
+	// Package usually has many exports of a few classes, so resolve each class reference only once.
+	// ClassIndex is in range [-ImportCount, ExportCount], it is used as index in ClassSlots array
+	// with ImportCount bias. Slot is index in Classes array, or INDEX_NONE if not resolved yet.
+	int Bias = package->Summary.ImportCount;
+	TArray<int> ClassSlots;
+	ClassSlots.Init(INDEX_NONE, Bias + package->Summary.ExportCount + 1);
+
+	Classes.Empty();
 	for (int idx = 0; idx < package->Summary.ExportCount; idx++)
 	{
-		const char* ObjectClass = package->GetObjectName(package->GetExport(idx).ClassIndex);
-
-		if (!stricmp(ObjectClass, "SkeletalMesh") || !stricmp(ObjectClass, "DestructibleMesh"))
-			file->NumSkeletalMeshes++;
-		else if (!stricmp(ObjectClass, "StaticMesh"))
-			file->NumStaticMeshes++;
-		else if (!stricmp(ObjectClass, "Animation") || !stricmp(ObjectClass, "MeshAnimation") || !stricmp(ObjectClass, "AnimSequence")) // whole AnimSet count for UE2 and number of sequences for UE3+
-			file->NumAnimations++;
-		else if (!strnicmp(ObjectClass, "Texture", 7))
-			file->NumTextures++;
+		int ClassIndex = package->GetExport(idx).ClassIndex;
+		if (unsigned(ClassIndex + Bias) >= unsigned(ClassSlots.Num()))
+			appError("Wrong class index %d for export %d", ClassIndex, idx);
+		int& Slot = ClassSlots[ClassIndex + Bias];
+		if (Slot == INDEX_NONE)
+		{
+			// different class references could have the same name
+			const char* ClassName = appStrdupPool(package->GetObjectName(ClassIndex));
+			for (Slot = 0; Slot < Classes.Num(); Slot++)
+			{
+				if (Classes[Slot].Name == ClassName) break;
+			}
+			if (Slot == Classes.Num())
+				new (Classes) ClassStats(ClassName);
+		}
+		Classes[Slot].Count++;
 	}
 /*	for (int j = 0; j < package->Summary.NameCount; j++)
 	{
@@ -221,36 +614,77 @@ static void ScanPackageExports(UnPackage* package, CGameFileInfo* file)
 			printf("%s : %s\n", package->NameTable[j], package->Filename);
 		}
 	} */
+
+	unguardf("%s", package->Filename);
+}
+
+static void CountPackageContent(CGameFileInfo* file, const TArray<ClassStats>& Classes)
+{
+	for (int i = 0; i < Classes.Num(); i++)
+	{
+		int* Counter = GetClassCounter(file, Classes[i].Name);
+		if (Counter) *Counter += Classes[i].Count;
+	}
 }
 
 
 bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback* Progress)
 {
+	guard(ScanContent);
+
 	bool cancelled = false;
-	for (int i = 0; i < Packages.Num(); i++)
-	{
-		CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[i]);		// we'll modify this structure here
-		if (file->PackageScanned) continue;
+	TArray<ClassStats> Classes;
+	TArray<const CGameFileInfo*> Batch;
+	TArray<UnPackage*> Loaded;
 
-		// Update progress dialog
-		if (Progress && !Progress->Progress(file->RelativeName, i, Packages.Num()))
+	int i = 0;
+	while (i < Packages.Num() && !cancelled)
+	{
+		// Collect packages for loading by worker threads. Progress and cache are handled here.
+		Batch.Empty();
+		for ( ; i < Packages.Num() && Batch.Num() < SCAN_BATCH_SIZE; i++)
 		{
-			cancelled = true;
-			break;
+			CGameFileInfo* file = const_cast<CGameFileInfo*>(Packages[i]);		// we'll modify this structure here
+			if (file->PackageScanned) continue;
+
+			// Update progress dialog
+			if (Progress && !Progress->Progress(file->RelativeName, i, Packages.Num()))
+			{
+				cancelled = true;
+				break;
+			}
+
+			file->PackageScanned = true;
+
+			CPackageCacheItem* Cached = GetPackageCacheItem(file);
+			if (Cached && Cached->bHasContent)
+			{
+				// use information from the previous scan
+				CountPackageContent(file, Cached->Classes);
+				continue;
+			}
+			Batch.Add(file);
 		}
+		if (!Batch.Num()) continue;
 
-		file->PackageScanned = true;
+		// Load packages (or get already loaded ones)
+		UnPackage::LoadPackages(Batch, Loaded);
 
-		if (file->Package)
+		for (int j = 0; j < Batch.Num(); j++)
 		{
-			// package already loaded
-			ScanPackageExports(file->Package, file);
-		}
-		else
-		{
-			UnPackage* package = UnPackage::LoadPackage(file->RelativeName, /*silent=*/ true);	// should always return non-NULL
+			CGameFileInfo* file = const_cast<CGameFileInfo*>(Batch[j]);
+			UnPackage* package = Loaded[j];
 			if (!package) continue;		// should not happen
-			ScanPackageExports(package, file);
+			ScanPackageExports(package, Classes);
+			CountPackageContent(file, Classes);
+
+			CPackageCacheItem* Cached = GetPackageCacheItem(file);
+			if (Cached)
+			{
+				CopyArray(Cached->Classes, Classes);
+				Cached->bHasContent = true;
+				GPackageCacheDirty = true;
+			}
 		#if 0
 			// this code is disabled: it works, however we're going to use ScanContent not just to get objects counts,
 			// but also for collecting object references
@@ -261,7 +695,10 @@ bool ScanContent(const TArray<const CGameFileInfo*>& Packages, IProgressCallback
 		#endif
 		}
 	}
+	SavePackageCache();
 	return !cancelled;
+
+	unguard;
 }
 
 
@@ -280,7 +717,7 @@ void CollectPackageStats(const TArray<UnPackage*> &Packages, TArray<ClassStats>&
 		UnPackage* pkg = Packages[i];
 		for (int j = 0; j < pkg->Summary.ExportCount; j++)
 		{
-			const FObjectExport &Exp = pkg->ExportTable[j];
+			const FObjectExport &Exp = pkg->GetExport(j);
 			const char* className = pkg->GetObjectName(Exp.ClassIndex);
 			ClassStats* found = NULL;
 			for (int k = 0; k < Stats.Num(); k++)
@@ -3,6 +3,7 @@
 #include "TypeInfo.h"
 
 #include "UnObject.h"		// dumping UObject in a few places
+#include "Parallel.h"
 
 #define MAX_CLASSES		256
 #define MAX_ENUMS		32
@@ -195,29 +196,135 @@ static TArray<PropPatch> Patches;
 	p->NewName   = NewName;
 }
 
-const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
+// Hash table of all properties of the type and its parents, with remaps applied. Names are
+// stored as appStrdupPool() strings, so most lookups are resolved with a pointer comparison.
+struct CPropHashEntry
 {
-	guard(CTypeInfo::FindProperty);
-	int i;
-	// check for remap
-	for (i = 0; i < Patches.Num(); i++)
+	const char			*Name;
+	uint32				NameHash;			// appGetPoolStringHash(Name)
+	const CPropInfo		*Prop;				// NULL for remapped property which doesn't exist
+	int					HashNext;
+};
+
+struct CPropHash
+{
+	TArray<CPropHashEntry> Entries;			// remapped names first, then properties in declaration order
+	TArray<int>			Buckets;			// index of first entry in chain, or -1
+	int					HashMask;
+
+	int Find(const char *PooledName) const
 	{
-		const PropPatch &p = Patches[i];
-		if (!stricmp(p.ClassName, this->Name) && !stricmp(p.OldName, Name))
+		uint32 Hash = appGetPoolStringHash(PooledName);
+		for (int i = Buckets[Hash & HashMask]; i >= 0; i = Entries[i].HashNext)
 		{
-			Name = p.NewName;
-			break;
+			const CPropHashEntry &E = Entries[i];
+			if (E.Name == PooledName || (E.NameHash == Hash && !stricmp(E.Name, PooledName)))
+				return i;
 		}
+		return -1;
 	}
-	// find property
-	for (const CTypeInfo *Type = this; Type; Type = Type->Parent)
+
+	void Add(const char *PropName, const CPropInfo *Prop)
 	{
-		for (i = 0; i < Type->NumProps; i++)
+		const char *PooledName = appStrdupPool(PropName);
+		if (Find(PooledName) >= 0) return;	// already overridden in derived type or remapped
+		int Index = Entries.Num();
+		CPropHashEntry *E = new (Entries) CPropHashEntry;
+		E->Name     = PooledName;
+		E->NameHash = appGetPoolStringHash(PooledName);
+		E->Prop     = Prop;
+		int &Bucket = Buckets[E->NameHash & HashMask];
+		E->HashNext = Bucket;
+		Bucket      = Index;
+	}
+};
+
+static CSpinLock PropHashLock;
+
+static const CPropInfo *FindPropertySlow(const CTypeInfo *StartType, const char *Name)
+{
+	for (const CTypeInfo *Type = StartType; Type; Type = Type->Parent)
+	{
+		for (int i = 0; i < Type->NumProps; i++)
 			if (!(stricmp(Type->Props[i].Name, Name)))
 				return Type->Props + i;
 	}
 	return NULL;
-	unguard;
+}
+
+static CPropHash *BuildPropHash(const CTypeInfo *Type)
+{
+	guard(BuildPropHash);
+
+	int NumProps = 0;
+	for (const CTypeInfo *T = Type; T; T = T->Parent)
+		NumProps += T->NumProps;
+
+	CPropHash *Hash = new CPropHash;
+	int NumBuckets = 16;
+	while (NumBuckets < NumProps * 2)
+		NumBuckets <<= 1;
+	Hash->HashMask = NumBuckets - 1;
+	Hash->Buckets.AddUninitialized(NumBuckets);
+	memset(Hash->Buckets.GetData(), -1, NumBuckets * sizeof(int));
+	Hash->Entries.Empty(NumProps);
+
+	// remaps are added first, so they will take precedence over properties with the same name
+	for (int i = 0; i < Patches.Num(); i++)
+	{
+		const PropPatch &p = Patches[i];
+		if (!stricmp(p.ClassName, Type->Name))
+			Hash->Add(p.OldName, FindPropertySlow(Type, p.NewName));
+	}
+	for (const CTypeInfo *T = Type; T; T = T->Parent)
+	{
+		for (int i = 0; i < T->NumProps; i++)
+			Hash->Add(T->Props[i].Name, T->Props + i);
+	}
+	return Hash;
+
+	unguardf("%s", Type->Name);
+}
+
+const CPropInfo *CTypeInfo::FindProperty(const FName& Name, int* Cursor) const
+{
+	guard(CTypeInfo::FindProperty);
+
+	const CPropHash *Hash = PropHash;
+	if (!Hash)
+	{
+		// SerializeUnrealProps() could be called from worker threads
+		TScopeLock<CSpinLock> Lock(PropHashLock);
+		Hash = PropHash;
+		if (!Hash)
+		{
+			Hash = BuildPropHash(this);
+			appInterlockedExchangePtr((void* volatile*)&PropHash, (void*)Hash);
+		}
+	}
+
+	int Index;
+	if (Cursor && *Cursor + 1 < Hash->Entries.Num() && Hash->Entries[*Cursor + 1].Name == Name.Str)
+	{
+		// properties are usually serialized in declaration order
+		Index = *Cursor + 1;
+	}
+	else
+	{
+		Index = Hash->Find(Name.Str);
+		if (Index < 0) return NULL;
+	}
+	if (Cursor) *Cursor = Index;
+	return Hash->Entries[Index].Prop;
+
+	unguardf("%s", *Name);
+}
+
+const CPropInfo *CTypeInfo::FindProperty(const char *Name) const
+{
+	FName PooledName;
+	PooledName = Name;
+	return FindProperty(PooledName);
 }
 
 
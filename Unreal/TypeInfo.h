@@ -71,6 +71,8 @@ struct CTypeInfo
 	const CPropInfo *Props;
 	int				NumProps;
 	void (*Constructor)(void*);
+	// property lookup table, built on first FindProperty() call
+	mutable struct CPropHash* volatile PropHash;
 	// methods
 	FORCEINLINE CTypeInfo(const char *AName, const CTypeInfo *AParent, int DataSize,
 					 const CPropInfo *AProps, int PropCount, void (*AConstructor)(void*))
@@ -80,13 +82,18 @@ struct CTypeInfo
 	,	Props(AProps)
 	,	NumProps(PropCount)
 	,	Constructor(AConstructor)
+	,	PropHash(NULL)
 	{}
 	inline bool IsClass() const
 	{
 		return (Name[0] == 'U') || (Name[0] == 'A');	// UE structure type names are started with 'F', classes with 'U' or 'A'
 	}
 	bool IsA(const char *TypeName) const;
+	// Find property by name, case-insensitive. 'Cursor' is an optional lookup hint, it holds position of
+	// the previously found property; should be initialized with -1 and reused for a sequence of calls.
+	const CPropInfo *FindProperty(const FName& Name, int* Cursor = NULL) const;
 	const CPropInfo *FindProperty(const char *Name) const;
+	// Should be called before loading any object of the class
 	static void RemapProp(const char *Class, const char *OldName, const char *NewName);
 
 	// Serialize Unreal engine UObject property block
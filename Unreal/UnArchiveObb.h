@@ -26,10 +26,8 @@ public:
 		guard(FObbFile::Serialize);
 		if (ArStopper > 0 && ArPos + size > ArStopper)
 			appError("Serializing behind stopper (%X+%X > %X)", ArPos, size, ArStopper);
-		// seek every time in a case if the same 'Reader' was used by different FObbFile
-		// (this is a lightweight operation for buffered FArchive)
-		Reader->Seek64(Info->Pos + ArPos);
-		Reader->Serialize(data, size);
+		// positional read: the same 'Reader' is shared by all FObbFile objects
+		Reader->ReadAt(Info->Pos + ArPos, data, size);
 		ArPos += size;
 		unguard;
 	}
@@ -142,8 +140,9 @@ protected:
 
 	const FObbEntry* FindFile(const char* name)
 	{
-		if (LastInfo && !stricmp(LastInfo->Name, name))
-			return LastInfo;
+		FObbEntry* Last = LastInfo;				// read once, could be changed by another thread
+		if (Last && !stricmp(Last->Name, name))
+			return Last;
 
 		for (int i = 0; i < FileInfos.Num(); i++)
 		{
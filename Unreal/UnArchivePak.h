@@ -57,15 +57,12 @@ struct FPakInfo
 	}
 };
 
+// Compressed block location, relative to FPakEntry::Pos. Blocks of all files are stored in a single
+// array owned by FPakVFS.
 struct FPakCompressedBlock
 {
-	int64		CompressedStart;
-	int64		CompressedEnd;
-
-	friend FArchive& operator<<(FArchive& Ar, FPakCompressedBlock& B)
-	{
-		return Ar << B.CompressedStart << B.CompressedEnd;
-	}
+	uint32		CompressedStart;
+	uint32		CompressedEnd;
 };
 
 struct FPakEntry
@@ -75,26 +72,32 @@ struct FPakEntry
 	int64		Size;
 	int64		UncompressedSize;
 	int32		CompressionMethod;
-	byte		Hash[20];
-	byte		bEncrypted;
-	TArray<FPakCompressedBlock> CompressionBlocks;
 	int32		CompressionBlockSize;
-
+	int32		FirstBlock;					// index in FPakVFS::CompressionBlocks
+	int32		NumBlocks;
 	int32		StructSize;					// computed value
-	FPakEntry*	HashNext;					// computed value
+	uint32		NameHash;					// computed value
+	byte		bEncrypted;
 
-	friend FArchive& operator<<(FArchive& Ar, FPakEntry& P)
+	// Blocks are appended to 'BlockPool'. Name is serialized separately.
+	void Serialize(FArchive& Ar, TArray<FPakCompressedBlock>& BlockPool)
 	{
-		guard(FPakEntry<<);
+		guard(FPakEntry::Serialize);
 
 		// FPakEntry is duplicated before each stored file, without a filename. So,
 		// remember the serialized size of this structure to avoid recomputation later.
 		int64 StartOffset = Ar.Tell64();
+		bool bRelativeBlocks = (Ar.PakVer >= PAK_RELATIVE_CHUNK_OFFSETS);
 
 #if GEARS4
 		if (GForceGame == GAME_Gears4)
 		{
-			Ar << P.Pos << (int32&)P.Size << (int32&)P.UncompressedSize << (byte&)P.CompressionMethod;
+			int32 Size32, UncompressedSize32;
+			byte Method8;
+			Ar << Pos << Size32 << UncompressedSize32 << Method8;
+			Size = Size32;
+			UncompressedSize = UncompressedSize32;
+			CompressionMethod = Method8;
 			if (Ar.PakVer < PAK_NO_TIMESTAMPS)
 			{
 				int64 timestamp;
@@ -102,17 +105,17 @@ struct FPakEntry
 			}
 			if (Ar.PakVer >= PAK_COMPRESSION_ENCRYPTION)
 			{
-				if (P.CompressionMethod != 0)
-					Ar << P.CompressionBlocks;
-				Ar << P.CompressionBlockSize;
-				if (P.CompressionMethod == 4)
-					P.CompressionMethod = COMPRESS_LZ4;
+				if (CompressionMethod != 0)
+					SerializeBlocks(Ar, BlockPool, false);
+				Ar << CompressionBlockSize;
+				if (CompressionMethod == 4)
+					CompressionMethod = COMPRESS_LZ4;
 			}
 			goto end;
 		}
 #endif // GEARS4
 
-		Ar << P.Pos << P.Size << P.UncompressedSize << P.CompressionMethod;
+		Ar << Pos << Size << UncompressedSize << CompressionMethod;
 
 		if (Ar.PakVer < PAK_NO_TIMESTAMPS)
 		{
@@ -120,36 +123,52 @@ struct FPakEntry
 			Ar << timestamp;
 		}
 
-		Ar.Serialize(ARRAY_ARG(P.Hash));
+		byte Hash[20];
+		Ar.Serialize(ARRAY_ARG(Hash));
 
 		if (Ar.PakVer >= PAK_COMPRESSION_ENCRYPTION)
 		{
-			if (P.CompressionMethod != 0)
-				Ar << P.CompressionBlocks;
-			Ar << P.bEncrypted << P.CompressionBlockSize;
+			if (CompressionMethod != 0)
+				SerializeBlocks(Ar, BlockPool, bRelativeBlocks);
+			Ar << bEncrypted << CompressionBlockSize;
 		}
 #if TEKKEN7
 		if (GForceGame == GAME_Tekken7)
-			P.bEncrypted = false;		// Tekken 7 has 'bEncrypted' flag set, but actually there's no encryption
+			bEncrypted = false;		// Tekken 7 has 'bEncrypted' flag set, but actually there's no encryption
 #endif
 
-		if (Ar.PakVer >= PAK_RELATIVE_CHUNK_OFFSETS)
+	end:
+		StructSize = Ar.Tell64() - StartOffset;
+
+		unguard;
+	}
+
+protected:
+	void SerializeBlocks(FArchive& Ar, TArray<FPakCompressedBlock>& BlockPool, bool bRelative)
+	{
+		int32 Count;
+		Ar << Count;
+		if (Count < 0 || Count > (Ar.GetFileSize64() - Ar.Tell64()) / 16)	// each block takes 16 bytes
+			appError("Wrong compression block count: %d", Count);
+		FirstBlock = BlockPool.Num();
+		NumBlocks = Count;
+		BlockPool.AddUninitialized(Count);
+		for (int i = 0; i < Count; i++)
 		{
-			// Convert relative compressed offsets to absolute
-			for (int i = 0; i < P.CompressionBlocks.Num(); i++)
+			int64 Start, End;
+			Ar << Start << End;
+			// convert absolute offsets to relative ones, as in UE4.20+
+			if (!bRelative)
 			{
-				FPakCompressedBlock& B = P.CompressionBlocks[i];
-				B.CompressedStart += P.Pos;
-				B.CompressedEnd += P.Pos;
+				Start -= Pos;
+				End -= Pos;
 			}
+			if (Start < 0 || End < Start || End > 0xFFFFFFFFu)
+				appError("Wrong compression block %d offsets", i);
+			FPakCompressedBlock& B = BlockPool[FirstBlock + i];
+			B.CompressedStart = (uint32)Start;
+			B.CompressedEnd = (uint32)End;
 		}
-
-	end:
-		P.StructSize = Ar.Tell64() - StartOffset;
-
-		return Ar;
-
-		unguard;
 	}
 };
 
@@ -164,25 +183,76 @@ inline bool PakRequireAesKey(bool fatal = true)
 	return true;
 }
 
+// Decompressed block of pak file entry. Blocks are stored in process-wide LRU cache shared by all
+// FPakFile readers, so the same data is not decompressed again when the file is reopened.
+struct FPakBlock
+{
+	// key
+	const FArchive*	Reader;			// identifies pak file
+	int64		EntryPos;			// identifies file inside pak
+	int			BlockIndex;
+	// data
+	byte*		Data;
+	int			Size;
+	// cache management
+	int			RefCount;
+	FPakBlock*	HashNext;
+	FPakBlock*	LruPrev;
+	FPakBlock*	LruNext;
+};
+
+// Implemented in GameFileSystem.cpp. Returned blocks are locked in cache until PakReleaseBlock() is called.
+// Find a block in cache, returns NULL when block is not cached.
+FPakBlock* PakFindBlock(const FArchive* Reader, int64 EntryPos, int BlockIndex);
+// Put data allocated with appMalloc into cache. If the same block was already added, Data is released, and
+// the existing block is returned.
+FPakBlock* PakAddBlock(const FArchive* Reader, int64 EntryPos, int BlockIndex, byte* Data, int Size);
+void PakReleaseBlock(FPakBlock* Block);
+
+class FPakFile;
+
+// Background decompression of a block which will be needed soon
+struct FPakPrefetchJob : public CJob
+{
+	FPakFile*	File;
+	int			BlockIndex;				// -1 when not used
+	FPakBlock*	Block;					// result, NULL if failed
+	FScratchBuffer Scratch;
+
+	FPakPrefetchJob()
+	:	BlockIndex(-1)
+	,	Block(NULL)
+	{}
+
+	virtual void Execute();
+};
+
 class FPakFile : public FArchive
 {
 	DECLARE_ARCHIVE(FPakFile, FArchive);
 public:
-	FPakFile(const FPakEntry* info, FArchive* reader)
+	FPakFile(const FPakEntry* info, const FPakCompressedBlock* blocks, FArchive* reader)
 	:	Info(info)
+	,	Blocks(blocks)
 	,	Reader(reader)
-	,	UncompressedBuffer(NULL)
+	,	UncompressedBufferPos(0)
+	,	UncompressedBufferSize(0)
+	,	DecryptWindowSize(0)
+	,	CurrentBlock(NULL)
+	,	LastBlockIndex(-1)
+	,	PrefetchJobs(NULL)
+	,	bNoPrefetch(false)
 	{}
 
 	virtual ~FPakFile()
 	{
-		if (UncompressedBuffer)
-			appFree(UncompressedBuffer);
+		Close();
 	}
 
 	virtual void Serialize(void *data, int size)
 	{
 		guard(FPakFile::Serialize);
+		ArPos -= DropReadWindow();
 		if (ArStopper > 0 && ArPos + size > ArStopper)
 			appError("Serializing behind stopper (%X+%X > %X)", ArPos, size, ArStopper);
 
@@ -192,48 +262,60 @@ public:
 
 			while (size > 0)
 			{
-				if ((UncompressedBuffer == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + Info->CompressionBlockSize))
+				if ((CurrentBlock == NULL) || (ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + CurrentBlock->Size))
 				{
 					// buffer is not ready
-					if (UncompressedBuffer == NULL)
+					if (CurrentBlock)
 					{
-						UncompressedBuffer = (byte*)appMalloc((int)Info->CompressionBlockSize); // size of uncompressed block
+						PakReleaseBlock(CurrentBlock);
+						CurrentBlock = NULL;
 					}
-					// prepare buffer
 					int BlockIndex = ArPos / Info->CompressionBlockSize;
 					UncompressedBufferPos = Info->CompressionBlockSize * BlockIndex;
-
-					const FPakCompressedBlock& Block = Info->CompressionBlocks[BlockIndex];
-					int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
-					int UncompressedBlockSize = min((int)Info->CompressionBlockSize, (int)Info->UncompressedSize - UncompressedBufferPos); // don't pass file end
-					byte* CompressedData;
-					if (!Info->bEncrypted)
+					int UncompressedBlockSize = GetBlockSize(BlockIndex);
+					// pick up the block decompressed in background
+					if (PrefetchJobs)
+						CurrentBlock = GetPrefetchedBlock(BlockIndex);
+					// the block could be already decompressed by another reader
+					if (!CurrentBlock)
+						CurrentBlock = PakFindBlock(Reader, Info->Pos, BlockIndex);
+					bool bDecompressedToDest = false;
+					if (!CurrentBlock)
 					{
-						CompressedData = (byte*)appMalloc(CompressedBlockSize);
-						Reader->Seek64(Block.CompressedStart);
-						Reader->Serialize(CompressedData, CompressedBlockSize);
+						if (ArPos == UncompressedBufferPos && size >= UncompressedBlockSize)
+						{
+							// whole block is requested, decompress it directly to destination without caching
+							DecompressBlock(BlockIndex, (byte*)data, UncompressedBlockSize, CompressedBuffer);
+							bDecompressedToDest = true;
+						}
+						else
+						{
+							byte* BlockData = (byte*)appMalloc(UncompressedBlockSize, 8, true);
+							DecompressBlock(BlockIndex, BlockData, UncompressedBlockSize, CompressedBuffer);
+							CurrentBlock = PakAddBlock(Reader, Info->Pos, BlockIndex, BlockData, UncompressedBlockSize);
+						}
 					}
-					else
+					// sequential reading: start decompression of next blocks
+					if (BlockIndex == LastBlockIndex + 1 && BlockIndex > 0 && !bNoPrefetch)
+						PrefetchBlocks(BlockIndex + 1);
+					LastBlockIndex = BlockIndex;
+					if (bDecompressedToDest)
 					{
-						int EncryptedSize = Align(CompressedBlockSize, EncryptionAlign);
-						CompressedData = (byte*)appMalloc(EncryptedSize);
-						Reader->Seek64(Block.CompressedStart);
-						Reader->Serialize(CompressedData, EncryptedSize);
-						PakRequireAesKey();
-						appDecryptAES(CompressedData, EncryptedSize);
+						ArPos += UncompressedBlockSize;
+						size  -= UncompressedBlockSize;
+						data  = OffsetPointer(data, UncompressedBlockSize);
+						continue;
 					}
-					appDecompress(CompressedData, CompressedBlockSize, UncompressedBuffer, UncompressedBlockSize, Info->CompressionMethod);
-					appFree(CompressedData);
 				}
 
 				// data is in buffer, copy it
-				int BytesToCopy = UncompressedBufferPos + Info->CompressionBlockSize - ArPos; // number of bytes until end of the buffer
+				int BytesToCopy = UncompressedBufferPos + CurrentBlock->Size - ArPos; // number of bytes until end of the buffer
 				if (BytesToCopy > size) BytesToCopy = size;
 				assert(BytesToCopy > 0);
 
 				// copy uncompressed data
 				int OffsetInBuffer = ArPos - UncompressedBufferPos;
-				memcpy(data, UncompressedBuffer + OffsetInBuffer, BytesToCopy);
+				memcpy(data, CurrentBlock->Data + OffsetInBuffer, BytesToCopy);
 
 				// advance pointers
 				ArPos += BytesToCopy;
@@ -248,36 +330,49 @@ public:
 			guard(SerializeEncrypted);
 
 			// Uncompressed encrypted data. Reuse compression fields to handle decryption efficiently
-			if (UncompressedBuffer == NULL)
-			{
-				UncompressedBuffer = (byte*)appMalloc(EncryptedBufferSize);
-				UncompressedBufferPos = 0x40000000; // some invalid value
-			}
 			while (size > 0)
 			{
-				if ((ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + EncryptedBufferSize))
+				if ((ArPos < UncompressedBufferPos) || (ArPos >= UncompressedBufferPos + UncompressedBufferSize))
 				{
+					UpdateDecryptWindow();
+					if (!(ArPos & (EncryptionAlign - 1)) && size >= DecryptWindowSize)
+					{
+						// Large aligned read, decrypt in place. Unaligned tail is read using the buffer.
+						int BytesToRead = size & ~(EncryptionAlign - 1);
+						Reader->ReadAt(Info->Pos + Info->StructSize + ArPos, data, BytesToRead);
+						PakRequireAesKey();
+						appDecryptAES((byte*)data, BytesToRead);
+						// advance pointers
+						ArPos += BytesToRead;
+						size  -= BytesToRead;
+						data  = OffsetPointer(data, BytesToRead);
+						// move the empty buffer to the new position, so the next read will be seen as sequential
+						UncompressedBufferPos = ArPos;
+						UncompressedBufferSize = 0;
+						continue;
+					}
 					// Should fetch block and decrypt it.
 					// Note: AES is block encryption, so we should always align read requests for correct decryption.
 					UncompressedBufferPos = ArPos & ~(EncryptionAlign - 1);
-					Reader->Seek64(Info->Pos + Info->StructSize + UncompressedBufferPos);
 					int RemainingSize = Info->Size - UncompressedBufferPos;
-					if (RemainingSize > EncryptedBufferSize)
-						RemainingSize = EncryptedBufferSize;
+					if (RemainingSize > DecryptWindowSize)
+						RemainingSize = DecryptWindowSize;
+					UncompressedBufferSize = RemainingSize;
 					RemainingSize = Align(RemainingSize, EncryptionAlign); // align for AES, pak contains aligned data
-					Reader->Serialize(UncompressedBuffer, RemainingSize);
+					byte* Buffer = DecryptBuffer.Get(RemainingSize);
+					Reader->ReadAt(Info->Pos + Info->StructSize + UncompressedBufferPos, Buffer, RemainingSize);
 					PakRequireAesKey();
-					appDecryptAES(UncompressedBuffer, RemainingSize);
+					appDecryptAES(Buffer, RemainingSize);
 				}
 
-				// Now copy decrypted data from UncompressedBuffer (code is very similar to those used in decompression above)
-				int BytesToCopy = UncompressedBufferPos + EncryptedBufferSize - ArPos; // number of bytes until end of the buffer
+				// Now copy decrypted data from DecryptBuffer (code is very similar to those used in decompression above)
+				int BytesToCopy = UncompressedBufferPos + UncompressedBufferSize - ArPos; // number of bytes until end of the buffer
 				if (BytesToCopy > size) BytesToCopy = size;
 				assert(BytesToCopy > 0);
 
 				// copy uncompressed data
 				int OffsetInBuffer = ArPos - UncompressedBufferPos;
-				memcpy(data, UncompressedBuffer + OffsetInBuffer, BytesToCopy);
+				memcpy(data, DecryptBuffer.Data + OffsetInBuffer, BytesToCopy);
 
 				// advance pointers
 				ArPos += BytesToCopy;
@@ -292,25 +387,77 @@ public:
 			guard(SerializeUncompressed);
 
 			// Pure data
-			// seek every time in a case if the same 'Reader' was used by different FPakFile
-			// (this is a lightweight operation for buffered FArchive)
-			Reader->Seek64(Info->Pos + Info->StructSize + ArPos);
-			Reader->Serialize(data, size);
+			// positional read: the same 'Reader' is shared by all FPakFile objects
+			Reader->ReadAt(Info->Pos + Info->StructSize + ArPos, data, size);
 			ArPos += size;
 
 			unguard;
 		}
+		SetupReadWindow();
 		unguardf("file=%s", Info->Name);
 	}
 
+	// Expose data after the current position to inline serializers: the rest of current decompressed
+	// block, decrypted data, or memory-mapped data of uncompressed file
+	void SetupReadWindow()
+	{
+		int DataEnd = (int)Info->UncompressedSize;
+		if (ArStopper > 0 && ArStopper < DataEnd) DataEnd = ArStopper;
+		const byte* Data = NULL;
+		int DataPos = 0;
+		if (Info->CompressionMethod)
+		{
+			if (!CurrentBlock) return;
+			Data = CurrentBlock->Data;
+			DataPos = UncompressedBufferPos;
+			DataEnd = min(DataEnd, UncompressedBufferPos + CurrentBlock->Size);
+		}
+		else if (Info->bEncrypted)
+		{
+			Data = DecryptBuffer.Data;
+			DataPos = UncompressedBufferPos;
+			DataEnd = min(DataEnd, UncompressedBufferPos + UncompressedBufferSize);
+		}
+		if (ArPos < DataPos || ArPos >= DataEnd) return;
+		if (!Data)
+		{
+			Data = Reader->BorrowData(Info->Pos + Info->StructSize + ArPos, DataEnd - ArPos);
+			if (!Data) return;
+			DataPos = ArPos;
+		}
+		ReadPtr = Data + (ArPos - DataPos);
+		ReadEnd = Data + (DataEnd - DataPos);
+		ArPos = DataEnd;
+	}
+
+	virtual const byte* BorrowData(int64 Pos, int size)
+	{
+		// only plain data could be accessed directly
+		if (Info->CompressionMethod || Info->bEncrypted) return NULL;
+		if (Pos < 0 || Pos + size > Info->UncompressedSize) return NULL;
+		return Reader->BorrowData(Info->Pos + Info->StructSize + Pos, size);
+	}
+
 	virtual void Seek(int Pos)
 	{
 		guard(FPakFile::Seek);
 		assert(Pos >= 0 && Pos < Info->UncompressedSize);
+		DropReadWindow();
 		ArPos = Pos;
 		unguardf("file=%s", Info->Name);
 	}
 
+	virtual int Tell() const
+	{
+		return ArPos - (int)(ReadEnd - ReadPtr);
+	}
+
+	virtual void SetStopper(int Pos)
+	{
+		ArPos -= DropReadWindow();
+		ArStopper = Pos;
+	}
+
 	virtual int GetFileSize() const
 	{
 		return (int)Info->UncompressedSize;
@@ -318,38 +465,210 @@ public:
 
 	virtual void Close()
 	{
-		if (UncompressedBuffer)
+		ArPos -= DropReadWindow();
+		if (PrefetchJobs)
+		{
+			for (int i = 0; i < NumPrefetchJobs; i++)
+				FinishPrefetchJob(PrefetchJobs[i]);
+			delete[] PrefetchJobs;
+			PrefetchJobs = NULL;
+		}
+		LastBlockIndex = -1;
+		DecryptBuffer.Free();
+		UncompressedBufferSize = DecryptWindowSize = 0;
+		if (CurrentBlock)
 		{
-			appFree(UncompressedBuffer);
-			UncompressedBuffer = NULL;
+			PakReleaseBlock(CurrentBlock);
+			CurrentBlock = NULL;
 		}
+		CompressedBuffer.Free();
 	}
 
 protected:
 	const FPakEntry* Info;
+	const FPakCompressedBlock* Blocks;	// Info->NumBlocks items
 	FArchive*	Reader;
-	byte*		UncompressedBuffer;
 	int			UncompressedBufferPos;
+	int			UncompressedBufferSize;	// size of decrypted data in DecryptBuffer
+	FScratchBuffer DecryptBuffer;	// used for encrypted data
+	int			DecryptWindowSize;		// amount of data decrypted at once, adjusted by access pattern
+	FPakBlock*	CurrentBlock;			// used for compressed data
+	int			LastBlockIndex;			// used to detect sequential reading
+	FPakPrefetchJob* PrefetchJobs;		// array of NumPrefetchJobs, allocated when sequential reading detected
+	bool		bNoPrefetch;
+	FScratchBuffer CompressedBuffer;	// used when compressed data is not memory-mapped, or should be decrypted
+
+	friend struct FPakPrefetchJob;
+
+	int GetBlockSize(int BlockIndex) const
+	{
+		// don't pass file end
+		return min((int)Info->CompressionBlockSize, (int)Info->UncompressedSize - (int)Info->CompressionBlockSize * BlockIndex);
+	}
+
+	// Blocks are decompressed in a worker thread only when decryption will not ask user for AES key.
+	// Note: worker threads use Reader->ReadAt(), which is thread-safe for FFileReader.
+	bool CanPrefetch()
+	{
+		if (appGetNumThreads() <= 1) return false;
+		if (Info->bEncrypted && GAesKey.Len() == 0) return false;
+		return true;
+	}
+
+	void PrefetchBlocks(int FirstBlock)
+	{
+		guard(FPakFile::PrefetchBlocks);
+
+		if (!PrefetchJobs)
+		{
+			if (!CanPrefetch())
+			{
+				// don't check it again for this file
+				bNoPrefetch = true;
+				return;
+			}
+			PrefetchJobs = new FPakPrefetchJob[NumPrefetchJobs];
+			for (int i = 0; i < NumPrefetchJobs; i++)
+				PrefetchJobs[i].File = this;
+		}
+
+		int LastBlock = min(FirstBlock + NumPrefetchJobs, Info->NumBlocks);
+		for (int BlockIndex = FirstBlock; BlockIndex < LastBlock; BlockIndex++)
+		{
+			FPakPrefetchJob& Job = PrefetchJobs[BlockIndex % NumPrefetchJobs];
+			if (Job.BlockIndex == BlockIndex) continue;		// already queued
+			// slot is occupied by a block which wasn't used (after seek)
+			FinishPrefetchJob(Job);
+			// check whether the block is already available
+			FPakBlock* Cached = PakFindBlock(Reader, Info->Pos, BlockIndex);
+			if (Cached)
+			{
+				PakReleaseBlock(Cached);
+				continue;
+			}
+			Job.BlockIndex = BlockIndex;
+			appQueueJob(&Job);
+		}
+
+		unguard;
+	}
+
+	FPakBlock* GetPrefetchedBlock(int BlockIndex)
+	{
+		FPakPrefetchJob& Job = PrefetchJobs[BlockIndex % NumPrefetchJobs];
+		if (Job.BlockIndex != BlockIndex) return NULL;
+		appWaitJob(&Job);
+		FPakBlock* Block = Job.Block;
+		// when the job failed, block will be decompressed again in this thread, so error will be reported
+		Job.Block = NULL;
+		Job.BlockIndex = -1;
+		return Block;
+	}
+
+	void FinishPrefetchJob(FPakPrefetchJob& Job)
+	{
+		if (Job.BlockIndex < 0) return;
+		appWaitJob(&Job);
+		if (Job.Block) PakReleaseBlock(Job.Block);
+		Job.Block = NULL;
+		Job.BlockIndex = -1;
+	}
+
+	void DecompressBlock(int BlockIndex, byte* Buffer, int UncompressedBlockSize, FScratchBuffer& Scratch)
+	{
+		guard(FPakFile::DecompressBlock);
+
+		assert(BlockIndex < Info->NumBlocks);
+		const FPakCompressedBlock& Block = Blocks[BlockIndex];
+		int CompressedBlockSize = (int)(Block.CompressedEnd - Block.CompressedStart);
+		int ReadSize = Info->bEncrypted ? Align(CompressedBlockSize, EncryptionAlign) : CompressedBlockSize;
+		int64 BlockPos = Info->Pos + Block.CompressedStart;
+		// note: this function is called from worker threads
+		const byte* MappedData = Reader->BorrowData(BlockPos, ReadSize);
+		byte* CompressedData = NULL;
+		if (!MappedData || Info->bEncrypted || appDecompressModifiesInput(Info->CompressionMethod))
+		{
+			CompressedData = Scratch.Get(ReadSize);
+			if (MappedData)
+			{
+				memcpy(CompressedData, MappedData, ReadSize);
+			}
+			else
+			{
+				Reader->ReadAt(BlockPos, CompressedData, ReadSize);
+			}
+			if (Info->bEncrypted)
+			{
+				PakRequireAesKey();
+				appDecryptAES(CompressedData, ReadSize);
+			}
+		}
+		appDecompress(CompressedData ? CompressedData : const_cast<byte*>(MappedData), CompressedBlockSize, Buffer, UncompressedBlockSize, Info->CompressionMethod);
+
+		unguardf("block=%d", BlockIndex);
+	}
+
+	// Called when requested encrypted data is not in the buffer. Works like FFileReader's read-ahead: the
+	// window grows while data is read sequentially, and shrinks on random access. Buffer memory is not
+	// released when the window shrinks.
+	void UpdateDecryptWindow()
+	{
+		if (!DecryptWindowSize)
+			DecryptWindowSize = DecryptWindowMinSize;
+		else if (ArPos >= UncompressedBufferPos + UncompressedBufferSize && ArPos < UncompressedBufferPos + UncompressedBufferSize + DecryptWindowSize)
+			DecryptWindowSize = min(DecryptWindowSize * 2, (int)DecryptWindowMaxSize);
+		else
+			DecryptWindowSize = max(DecryptWindowSize / 2, (int)DecryptWindowMinSize);
+	}
+
+	enum { NumPrefetchJobs = 4 };		// number of blocks decompressed ahead
 
 	enum { EncryptionAlign = 16 }; // AES-specific constant
-	enum { EncryptedBufferSize = 256 }; //?? TODO: check - may be value 16 will be better for performance
+	enum { DecryptWindowMinSize = 4096 };
+	enum { DecryptWindowMaxSize = 4 << 20 };
 };
 
+inline void FPakPrefetchJob::Execute()
+{
+	Block = PakFindBlock(File->Reader, File->Info->Pos, BlockIndex);
+	if (Block) return;
+
+	int Size = File->GetBlockSize(BlockIndex);
+	byte* Data = (byte*)appMalloc(Size, 8, true);
+	// don't report errors here, failed block will be decompressed again when needed
+	TRY
+	{
+		File->DecompressBlock(BlockIndex, Data, Size, Scratch);
+	}
+	CATCH
+	{
+		appFree(Data);
+		GErrorHistory[0] = 0;
+		return;
+	}
+	Block = PakAddBlock(File->Reader, File->Info->Pos, BlockIndex, Data, Size);
+}
+
 
 class FPakVFS : public FVirtualFileSystem
 {
 public:
 	FPakVFS(const char* InFilename)
-	:	Filename(InFilename)
+	:	AllowAesKeyPrompt(true)
+	,	NeedsAesKey(false)
+	,	Filename(InFilename)
 	,	Reader(NULL)
+	,	CacheReader(NULL)
 	,	LastInfo(NULL)
 	,	HashTable(NULL)
+	,	HashSize(0)
 	{}
 
 	virtual ~FPakVFS()
 	{
 		delete Reader;
-		if (HashTable) delete[] HashTable;
+		delete CacheReader;
+		if (HashTable) appFree(HashTable);
 	}
 
 	virtual bool AttachReader(FArchive* reader)
@@ -370,6 +689,12 @@ public:
 
 		if (info.bEncryptedIndex)
 		{
+			if (GAesKey.Len() == 0 && !AllowAesKeyPrompt)
+			{
+				// Can't ask user for a key now, the caller should mount this pak again
+				NeedsAesKey = true;
+				return false;
+			}
 			if (!PakRequireAesKey(false))
 			{
 				appNotify("WARNING: Pak \"%s\" has encrypted index. Skipping.", *Filename);
@@ -384,6 +709,10 @@ public:
 
 		Reader->ArLicenseeVer = info.Version;
 
+		// Try to use previously parsed index
+		if (LoadIndexCache(info))
+			return true;
+
 		Reader->Seek64(info.IndexOffset);
 
 		// Manage pak files with encrypted index
@@ -403,8 +732,6 @@ public:
 
 		// Read pak index
 
-		FStaticString<MAX_PACKAGE_PATH> MountPoint;
-
 		TRY {
 			// Read MountPoint with catching error, to override error message.
 			*InfoReader << MountPoint;
@@ -436,7 +763,6 @@ public:
 		*InfoReader << count;
 		FileInfos.AddZeroed(count);
 
-		int numEncryptedFiles = 0;
 		for (int i = 0; i < count; i++)
 		{
 			FPakEntry& E = FileInfos[i];
@@ -448,21 +774,9 @@ public:
 			CombinedPath += Filename;
 			E.Name = appStrdupPool(*CombinedPath);
 			// serialize other fields
-			*InfoReader << E;
-			if (E.bEncrypted)
-			{
-//				appPrintf("Encrypted file: %s\n", *Filename);
-				numEncryptedFiles++;
-			}
-		}
-		if (count >= MIN_PAK_SIZE_FOR_HASHING)
-		{
-			// Hash everything
-			for (int i = 0; i < count; i++)
-			{
-				AddFileToHash(&FileInfos[i]);
-			}
+			E.Serialize(*InfoReader, CompressionBlocks);
 		}
+		BuildHash();
 		// Cleanup
 		if (InfoBlock)
 		{
@@ -470,13 +784,7 @@ public:
 			delete InfoReaderProxy;
 		}
 
-		// Print statistics
-		appPrintf("Pak %s: %d files", *Filename, count);
-		if (numEncryptedFiles)
-			appPrintf(" (%d encrypted)", numEncryptedFiles);
-		if (strcmp(*MountPoint, "/") != 0)
-			appPrintf(", mount point: \"%s\"", *MountPoint);
-		appPrintf("\n");
+		SaveIndexCache(info);
 
 		return true;
 
@@ -511,69 +819,81 @@ public:
 			appPrintf("pak(%s): attempt to open encrypted file %s\n", *Filename, name);
 			return NULL;
 		} */
-		return new FPakFile(info, Reader);
+		return new FPakFile(info, info->NumBlocks ? &CompressionBlocks[info->FirstBlock] : NULL, Reader);
 	}
 
-protected:
-	enum { HASH_SIZE = 1024 };
-	enum { HASH_MASK = HASH_SIZE - 1 };
-	enum { MIN_PAK_SIZE_FOR_HASHING = 256 };
+	void PrintStats() const
+	{
+		int numEncryptedFiles = 0;
+		for (int i = 0; i < FileInfos.Num(); i++)
+		{
+			if (FileInfos[i].bEncrypted)
+				numEncryptedFiles++;
+		}
+		appPrintf("Pak %s: %d files", *Filename, FileInfos.Num());
+		if (numEncryptedFiles)
+			appPrintf(" (%d encrypted)", numEncryptedFiles);
+		if (strcmp(*MountPoint, "/") != 0)
+			appPrintf(", mount point: \"%s\"", *MountPoint);
+		appPrintf("\n");
+	}
 
+	// When false, AttachReader() will not ask user for AES key, and will fail with NeedsAesKey set
+	bool				AllowAesKeyPrompt;
+	bool				NeedsAesKey;
+
+protected:
 	FString				Filename;
 	FArchive*			Reader;
+	FArchive*			CacheReader;		// memory-mapped index cache, FPakEntry::Name points inside it
+	FStaticString<MAX_PACKAGE_PATH> MountPoint;
 	TArray<FPakEntry>	FileInfos;
+	TArray<FPakCompressedBlock> CompressionBlocks; // blocks of all files, see FPakEntry::FirstBlock
 	FPakEntry*			LastInfo;			// cached last accessed file info, simple optimization
-	FPakEntry**			HashTable;
+	int32*				HashTable;			// open addressing, indices in FileInfos, -1 for empty slot
+	int					HashSize;			// power of 2, at least twice larger than number of files
 
-	static uint16 GetHashForFileName(const char* FileName)
+	void BuildHash()
 	{
-		uint16 hash = 0;
-		while (char c = *FileName++)
-		{
-			if (c >= 'A' && c <= 'Z') c += 'a' - 'A'; // lowercase a character
-			hash = ROL16(hash, 5) - hash + ((c << 4) + c ^ 0x13F);	// some crazy hash function
-		}
-		hash &= HASH_MASK;
-		return hash;
-	}
+		guard(FPakVFS::BuildHash);
 
-	void AddFileToHash(FPakEntry* File)
-	{
-		if (!HashTable)
+		HashSize = 16;
+		while (HashSize < FileInfos.Num() * 2)
+			HashSize *= 2;
+		HashTable = (int32*)appMalloc(HashSize * sizeof(int32), 8, true);
+		memset(HashTable, 0xFF, HashSize * sizeof(int32));
+
+		int mask = HashSize - 1;
+		for (int i = 0; i < FileInfos.Num(); i++)
 		{
-			HashTable = new FPakEntry* [HASH_SIZE];
-			memset(HashTable, 0, sizeof(FPakEntry*) * HASH_SIZE);
+			FPakEntry& E = FileInfos[i];
+			E.NameHash = appStrihash(E.Name);
+			int index = E.NameHash & mask;
+			while (HashTable[index] >= 0)
+				index = (index + 1) & mask;
+			HashTable[index] = i;
 		}
-		uint16 hash = GetHashForFileName(File->Name);
-		File->HashNext = HashTable[hash];
-		HashTable[hash] = File;
+
+		unguard;
 	}
 
+	// Persistent index cache, implemented in GameFileSystem.cpp
+	bool LoadIndexCache(const FPakInfo& info);
+	void SaveIndexCache(const FPakInfo& info);
+
 	const FPakEntry* FindFile(const char* name)
 	{
-		if (LastInfo && !stricmp(LastInfo->Name, name))
-			return LastInfo;
-
-		if (HashTable)
-		{
-			// Have a hash table, use it
-			uint16 hash = GetHashForFileName(name);
-			for (FPakEntry* info = HashTable[hash]; info; info = info->HashNext)
-			{
-				if (!stricmp(info->Name, name))
-				{
-					LastInfo = info;
-					return info;
-				}
-			}
-			return NULL;
-		}
-
-		// Linear search without a hash table
-		for (int i = 0; i < FileInfos.Num(); i++)
+		FPakEntry* Last = LastInfo;				// read once, could be changed by another thread
+		if (Last && !stricmp(Last->Name, name))
+			return Last;
+
+		if (!HashTable) return NULL;
+		uint32 hash = appStrihash(name);
+		int mask = HashSize - 1;
+		for (int index = hash & mask; HashTable[index] >= 0; index = (index + 1) & mask)
 		{
-			FPakEntry* info = &FileInfos[i];
-			if (!stricmp(info->Name, name))
+			FPakEntry* info = &FileInfos[HashTable[index]];
+			if (info->NameHash == hash && !stricmp(info->Name, name))
 			{
 				LastInfo = info;
 				return info;
@@ -1,5 +1,6 @@
 #include "Core.h"
 #include "UnCore.h"
+#include "Parallel.h"
 
 
 int  GForceGame           = GAME_UNKNOWN;
@@ -11,11 +12,15 @@ byte GForcePlatform       = PLATFORM_UNKNOWN;
 
 int GNumSerialize = 0;
 int GSerializeBytes = 0;
+int GNumBufferHits = 0;
+int GNumPakBlockHits = 0;
+int GNumPakBlockMisses = 0;
 static int ProfileStartTime = -1;
 
 void appResetProfiler()
 {
-	GNumAllocs = GNumSerialize = GSerializeBytes = 0;
+	GNumAllocs = GNumSerialize = GSerializeBytes = GNumBufferHits = 0;
+	GNumPakBlockHits = GNumPakBlockMisses = 0;
 	ProfileStartTime = appMilliseconds();
 }
 
@@ -26,8 +31,19 @@ void appPrintProfiler()
 	float timeDelta = (appMilliseconds() - ProfileStartTime) / 1000.0f;
 	if (timeDelta < 0.001f && !GNumAllocs && !GSerializeBytes && !GNumSerialize)
 		return;		// perhaps already printed?
-	appPrintf("Loaded in %.2g sec, %d allocs, %.2f MBytes serialized in %d calls.\n",
+	appPrintf("Loaded in %.2g sec, %d allocs, %.2f MBytes serialized in %d calls",
 		timeDelta, GNumAllocs, GSerializeBytes / (1024.0f * 1024.0f), GNumSerialize);
+	if (GNumBufferHits)
+	{
+		// FFileReader statistics: percent of reads served from the buffer without accessing the file
+		appPrintf(", %.1f%% buffer hits", GNumBufferHits * 100.0f / (GNumBufferHits + GNumSerialize));
+	}
+	if (GNumPakBlockHits + GNumPakBlockMisses)
+	{
+		// cache of decompressed pak blocks
+		appPrintf(", pak blocks: %d cached, %d decompressed", GNumPakBlockHits, GNumPakBlockMisses);
+	}
+	appPrintf(".\n");
 	appResetProfiler();
 }
 
@@ -455,40 +471,60 @@ struct CStringPoolEntry
 {
 	CStringPoolEntry*	HashNext;
 	int					Length;
+	uint32				NoCaseHash;			// should be placed right before Str, see appGetPoolStringHash()
 	char				Str[1];
 };
 
+// "None" string used by FName constructor, it is added to the pool with the first appStrdupPool() call
+struct CStaticPoolString
+{
+	CStringPoolEntry*	HashNext;
+	int					Length;
+	uint32				NoCaseHash;
+	char				Str[5];
+};
+
+static_assert(offsetof(CStringPoolEntry, Str) == offsetof(CStringPoolEntry, NoCaseHash) + sizeof(uint32), "Wrong CStringPoolEntry layout");
+static_assert(offsetof(CStaticPoolString, Str) == offsetof(CStringPoolEntry, Str), "Wrong CStaticPoolString layout");
+
+static CStaticPoolString NoneString = { NULL, 4, 0, "None" };
+const char* const GNoneName = NoneString.Str;
+
 static CStringPoolEntry* StringHashTable[STRING_HASH_SIZE];
 static CMemoryChain* StringPool;
+static CSpinLock StringPoolLock;
 
 const char* appStrdupPool(const char* str)
 {
 	int len = strlen(str);
-	int hash = 0;
-	for (int i = 0; i < len; i++)
+	uint32 NoCaseHash = appStrihash(str, len);
+	int hash = NoCaseHash & (STRING_HASH_SIZE - 1);
+
+	TScopeLock<CSpinLock> Lock(StringPoolLock);
+
+	if (!StringPool)
 	{
-		char c = str[i];
-#if 0
-		hash = (hash + c) ^ 0xABCDEF;
-#else
-		hash = ROL16(hash, 5) - hash + ((c << 4) + c ^ 0x13F);	// some crazy hash function
-#endif
+		StringPool = new CMemoryChain();
+		// register static "None" string
+		CStringPoolEntry* none = (CStringPoolEntry*)&NoneString;
+		none->NoCaseHash = appStrihash(none->Str);
+		int noneHash = none->NoCaseHash & (STRING_HASH_SIZE - 1);
+		none->HashNext = StringHashTable[noneHash];
+		StringHashTable[noneHash] = none;
 	}
-	hash &= (STRING_HASH_SIZE - 1);
 
 	for (const CStringPoolEntry* s = StringHashTable[hash]; s; s = s->HashNext)
 	{
-		if (s->Length == len && !strcmp(str, s->Str))		// found a string
+		if (s->NoCaseHash == NoCaseHash && s->Length == len && !strcmp(str, s->Str))		// found a string
 			return s->Str;
 	}
 
-	if (!StringPool) StringPool = new CMemoryChain();
-
 	// allocate new string from pool
 	CStringPoolEntry* n = (CStringPoolEntry*)StringPool->Alloc(sizeof(CStringPoolEntry) + len);	// note: null byte is taken into account in CStringPoolEntry
 	n->HashNext = StringHashTable[hash];
 	StringHashTable[hash] = n;
 	n->Length = len;
+	n->NoCaseHash = NoCaseHash;
 	memcpy(n->Str, str, len+1);
 
 	return n->Str;
@@ -60,6 +60,9 @@ class UnPackage;
 #if PROFILE
 extern int GNumSerialize;
 extern int GSerializeBytes;
+extern int GNumBufferHits;
+extern int GNumPakBlockHits;
+extern int GNumPakBlockMisses;
 
 void appResetProfiler();
 void appPrintProfiler();
@@ -90,14 +93,26 @@ void appSetRootDirectory(const char *dir, bool recurse = true);
 void appSetRootDirectory2(const char *filename);
 const char *appGetRootDirectory();
 
+// Directory for persistent cache files (e.g. parsed pak indices). Empty string disables caching.
+void appSetCacheDirectory(const char *dir);
+const char *appGetCacheDirectory();
+// Open memory-mapped cache file and validate its layout: header of HeaderSize bytes, where first KeySize
+// bytes should match Key, and int32 NumEntries, NumItems and NamesSize are stored at CountsOffset; then
+// NumEntries entries of EntrySize bytes, NumItems items of ItemSize bytes and NamesSize bytes of names.
+// Returns NULL when cache can't be used, otherwise Reader holds the data and should be deleted by caller.
+const byte* appOpenCacheFile(const char *Filename, const void *Key, int KeySize, int HeaderSize, int CountsOffset,
+	int EntrySize, int ItemSize, FArchive *&Reader);
+
 struct CGameFileInfo
 {
 	const char*	RelativeName;						// relative to RootDirectory
 	const char*	ShortFilename;						// without path, points to filename part of RelativeName
 	const char*	Extension;							// points to extension part (excluding '.') of RelativeName
 	CGameFileInfo* HashNext;						// used for fast search; computed from ShortFilename excluding extension
+	int			FileIndex;							// registration order, used for sorting results of directory queries
 	bool		IsPackage;
 	int64		Size;								// file size, in bytes
+	int64		Time;								// modification time; for files inside VFS it is the time of container file
 	int32		SizeInKb;							// file size, in kilobytes
 	int			ExtraSizeInKb;						// size of additional non-package files
 	class FVirtualFileSystem* FileSystem;			// owning virtual file system (NULL for OS file system)
@@ -111,10 +126,12 @@ struct CGameFileInfo
 
 	void UpdateFrom(const CGameFileInfo* other)
 	{
-		// Copy information from 'other' entry, but preserve hash chains
+		// Copy information from 'other' entry, but preserve hash chains and registration order
 		CGameFileInfo* saveHash = HashNext;
+		int saveIndex = FileIndex;
 		memcpy(this, other, sizeof(CGameFileInfo));
 		HashNext = saveHash;
+		FileIndex = saveIndex;
 	}
 };
 
@@ -125,10 +142,19 @@ extern int GNumForeignFiles;
 // Filename can contain extension, but should not contain path.
 // This function is quite fast because it uses hash tables.
 const CGameFileInfo *appFindGameFile(const char *Filename, const char *Ext = NULL);
-// This function allows wildcard use in Filename. When wildcard is used, it iterates over all
-// found files and could be relatively slow.
+// This function allows wildcard use in Filename. When wildcard contains a path, only files from
+// the directory matching the wildcard's prefix are checked, otherwise it iterates over all found
+// files and could be relatively slow.
 void appFindGameFiles(const char *Filename, TArray<const CGameFileInfo*>& Files);
 
+// Get packages (Ext = NULL) or files with specified extension from the directory. Path is relative
+// to the root directory, without trailing slash; empty string means root directory. When Recurse is
+// true, files from subdirectories are returned too. Files are returned in registration order.
+// Returns false when directory does not exist.
+bool appGetGameFolderFiles(const char *Path, TArray<const CGameFileInfo*>& Files, bool Recurse = false, const char *Ext = NULL);
+// Get list of directories which contain packages, in registration order
+void appGetGameFolders(TArray<const char*>& Folders);
+
 const char *appSkipRootDir(const char *Filename);
 FArchive *appCreateFileReader(const CGameFileInfo *info);
 
@@ -163,6 +189,14 @@ extern const char *GStartupPackage;
 
 const char* appStrdupPool(const char* str);
 
+// Case-insensitive hash of the string returned by appStrdupPool()
+FORCEINLINE uint32 appGetPoolStringHash(const char* PooledStr)
+{
+	return ((const uint32*)PooledStr)[-1];
+}
+
+extern const char* const GNoneName;			// pooled "None" string
+
 class FName
 {
 public:
@@ -170,11 +204,11 @@ public:
 #if UNREAL3 || UNREAL4
 	int			ExtraIndex;
 #endif
-	const char	*Str;
+	const char	*Str;						// should always be allocated with appStrdupPool()
 
 	FName()
 	:	Index(0)
-	,	Str("None")
+	,	Str(GNoneName)
 #if UNREAL3 || UNREAL4
 	,	ExtraIndex(0)
 #endif
@@ -202,8 +236,10 @@ public:
 
 	inline bool operator==(const FName& Other) const
 	{
-		// we're using appStrdupPool for FName strings, so perhaps comparison of pointers is enough here
-		return (Str == Other.Str) || (stricmp(Str, Other.Str) == 0);
+		// we're using appStrdupPool for FName strings, so comparison of pointers is enough for names with
+		// the same case; otherwise compare hashes, and call stricmp() only when strings are most likely equal
+		return (Str == Other.Str) ||
+			(appGetPoolStringHash(Str) == appGetPoolStringHash(Other.Str) && stricmp(Str, Other.Str) == 0);
 	}
 
 	inline bool operator==(const char* String) const
@@ -423,6 +459,13 @@ public:
 	bool	IsLoading;
 	bool	ReverseBytes;
 
+	// Read window: data at the current archive position which is consumed by inline serializers
+	// without a virtual Serialize() call. Reader archives set it up in Serialize(), limited by the
+	// stopper, and drop it on Seek(), SetStopper() and Close(). Archive position is kept at ReadEnd,
+	// so unread window bytes should be subtracted from it.
+	const byte* ReadPtr;
+	const byte* ReadEnd;
+
 protected:
 	int		ArPos;
 	int		ArStopper;
@@ -439,6 +482,8 @@ public:
 	,	ArLicenseeVer(0)
 	,	IsLoading(true)
 	,	ReverseBytes(false)
+	,	ReadPtr(NULL)
+	,	ReadEnd(NULL)
 	,	Game(GAME_UNKNOWN)
 	,	Platform(PLATFORM_PC)
 	{}
@@ -522,6 +567,71 @@ public:
 	virtual void Serialize(void *data, int size) = 0;
 	void ByteOrderSerialize(void *data, int size);
 
+	// Versions of Serialize() and ByteOrderSerialize() which read from the read window when possible.
+	FORCEINLINE void InlineSerialize(void *data, int size)
+	{
+		if (ReadEnd - ReadPtr >= size)
+		{
+			memcpy(data, ReadPtr, size);
+			ReadPtr += size;
+		}
+		else
+		{
+			Serialize(data, size);
+		}
+	}
+	// Used for 2, 4 and 8-byte values only.
+	FORCEINLINE void InlineByteOrderSerialize(void *data, int size)
+	{
+		if (ReadEnd - ReadPtr >= size)
+		{
+			memcpy(data, ReadPtr, size);
+			ReadPtr += size;
+			if (ReverseBytes)
+			{
+				// 'size' is a constant here, so only one of these lines is compiled
+				if (size == 2)
+					*(uint16*)data = BSWAP16(*(uint16*)data);
+				else if (size == 4)
+					*(uint32*)data = BSWAP32(*(uint32*)data);
+				else if (size == 8)
+					*(uint64*)data = BSWAP64(*(uint64*)data);
+			}
+		}
+		else
+		{
+			ByteOrderSerialize(data, size);
+		}
+	}
+
+	// Drop the read window. Returns number of unread window bytes, so the archive could move its
+	// position back.
+	FORCEINLINE int DropReadWindow()
+	{
+		int Unread = (int)(ReadEnd - ReadPtr);
+		ReadPtr = ReadEnd = NULL;
+		return Unread;
+	}
+
+	// Zero-copy access to archive data. Returns pointer to 'size' bytes at position 'Pos' when
+	// archive has these bytes in memory (memory-mapped file or memory buffer), or NULL otherwise.
+	// Archive position is not changed. Pointer remains valid until the archive is closed.
+	virtual const byte* BorrowData(int64 Pos, int size)
+	{
+		return NULL;
+	}
+
+	// Positional read: reads 'size' bytes at position 'Pos', archive position is not changed. FFileReader
+	// and FMemReader allow calling it from different threads at the same time. Default implementation
+	// uses Seek64() and Serialize(), so it is not thread-safe.
+	virtual void ReadAt(int64 Pos, void *data, int size)
+	{
+		int64 OldPos = Tell64();
+		Seek64(Pos);
+		Serialize(data, size);
+		Seek64(OldPos);
+	}
+
 	// "Stopper" is used to check for overrun serialization.
 	// Note: there's no 64-bit "stopper" - large files are used only as containers for smaller
 	// files, so stopper validation is performed on upper level, with 32-bit values.
@@ -630,53 +740,53 @@ private:
 FORCEINLINE FArchive& operator<<(FArchive &Ar, bool &B)
 {
 	int32 b32 = B;
-	Ar.Serialize(&b32, 4);
+	Ar.InlineSerialize(&b32, 4);
 	if (Ar.IsLoading) B = (b32 != 0);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, char &B) // int8
 {
-	Ar.Serialize(&B, 1);
+	Ar.InlineSerialize(&B, 1);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, byte &B) // uint8
 {
-	Ar.Serialize(&B, 1);
+	Ar.InlineSerialize(&B, 1);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, int16 &B)
 {
-	Ar.ByteOrderSerialize(&B, 2);
+	Ar.InlineByteOrderSerialize(&B, 2);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, uint16 &B)
 {
-	Ar.ByteOrderSerialize(&B, 2);
+	Ar.InlineByteOrderSerialize(&B, 2);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, int32 &B)
 {
-	Ar.ByteOrderSerialize(&B, 4);
+	Ar.InlineByteOrderSerialize(&B, 4);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, uint32 &B)
 {
-	Ar.ByteOrderSerialize(&B, 4);
+	Ar.InlineByteOrderSerialize(&B, 4);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, int64 &B)
 {
-	Ar.ByteOrderSerialize(&B, 8);
+	Ar.InlineByteOrderSerialize(&B, 8);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, uint64 &B)
 {
-	Ar.ByteOrderSerialize(&B, 8);
+	Ar.InlineByteOrderSerialize(&B, 8);
 	return Ar;
 }
 FORCEINLINE FArchive& operator<<(FArchive &Ar, float &B)
 {
-	Ar.ByteOrderSerialize(&B, 4);
+	Ar.InlineByteOrderSerialize(&B, 4);
 	return Ar;
 }
 
@@ -703,6 +813,7 @@ enum EFileArchiveOptions
 {
 	FAO_NoOpenError = 1,
 	FAO_TextFile = 2,
+	FAO_NoMemoryMap = 4,			// FFileReader: use buffered reads instead of mapping the file to memory
 };
 
 class FFileArchive : public FArchive
@@ -736,7 +847,14 @@ protected:
 	int64		ArPos64;
 	int64		FilePos;		// where 'f' position points to (when reading, it usually equals to 'BufferPos + BufferSize')
 
+	const byte*	MappedData;		// not NULL when the whole file is mapped to memory
+#if _WIN32
+	void*		MappingHandle;	// HANDLE of file mapping object
+#endif
+
 	bool OpenFile();
+	bool MapFile();
+	void UnmapFile();
 };
 
 
@@ -760,8 +878,29 @@ public:
 	virtual ~FFileReader();
 
 	virtual void Serialize(void *data, int size);
+	virtual const byte* BorrowData(int64 Pos, int size);
+	virtual void ReadAt(int64 Pos, void *data, int size);
 	virtual bool Open();
+	virtual void Close();
 	virtual int64 GetFileSize64() const;
+
+	// Read window support
+	virtual void Seek(int Pos);
+	virtual void Seek64(int64 Pos);
+	virtual int Tell() const;
+	virtual int64 Tell64() const;
+	virtual bool IsEof() const;
+	virtual void SetStopper(int Pos);
+
+protected:
+	int			BufferCapacity;	// allocated size of Buffer, adjusted by access pattern
+	int			ReadAheadHint;	// last posix_fadvise() value
+#if _WIN32
+	void* volatile OverlappedHandle; // HANDLE opened with FILE_FLAG_OVERLAPPED, used by ReadAt()
+#endif
+
+	void UpdateReadAhead();
+	void SetupReadWindow();
 };
 
 
@@ -784,6 +923,40 @@ protected:
 };
 
 
+// Reusable buffer for compressed data, grows only
+struct FScratchBuffer
+{
+	byte*		Data;
+	int			Size;
+
+	FScratchBuffer()
+	:	Data(NULL)
+	,	Size(0)
+	{}
+	~FScratchBuffer()
+	{
+		Free();
+	}
+
+	byte* Get(int NewSize)
+	{
+		if (NewSize > Size)
+		{
+			if (Data) appFree(Data);
+			Data = (byte*)appMalloc(NewSize, 16, true);
+			Size = NewSize;
+		}
+		return Data;
+	}
+
+	void Free()
+	{
+		if (Data) appFree(Data);
+		Data = NULL;
+		Size = 0;
+	}
+};
+
 // NOTE: this class should work well as a writer too!
 class FReaderWrapper : public FArchive
 {
@@ -791,10 +964,13 @@ class FReaderWrapper : public FArchive
 public:
 	FArchive	*Reader;
 	int			ArPosOffset;
+	bool		PassThrough;		// data is not transformed, so direct access to the underlying reader is allowed
 
-	FReaderWrapper(FArchive *File, int Offset = 0)
+	// Derived classes are used for game-specific decryption and should keep PassThrough disabled
+	FReaderWrapper(FArchive *File, int Offset = 0, bool InPassThrough = false)
 	:	Reader(File)
 	,	ArPosOffset(Offset)
+	,	PassThrough(InPassThrough)
 	{}
 	virtual ~FReaderWrapper()
 	{
@@ -820,6 +996,18 @@ public:
 	{
 		Reader->Serialize(data, size);
 	}
+	virtual const byte* BorrowData(int64 Pos, int size)
+	{
+		if (!PassThrough) return NULL;
+		return Reader->BorrowData(Pos + ArPosOffset, size);
+	}
+	virtual void ReadAt(int64 Pos, void *data, int size)
+	{
+		if (!PassThrough)
+			FArchive::ReadAt(Pos, data, size);
+		else
+			Reader->ReadAt(Pos + ArPosOffset, data, size);
+	}
 	virtual void SetStopper(int Pos)
 	{
 		Reader->SetStopper(Pos + ArPosOffset);
@@ -859,24 +1047,60 @@ public:
 	{
 		guard(FMemReader::Seek);
 		assert(Pos >= 0 && Pos <= DataSize);
+		DropReadWindow();
 		ArPos = Pos;
 		unguard;
 	}
 
+	virtual int Tell() const
+	{
+		return ArPos - (int)(ReadEnd - ReadPtr);
+	}
+
 	virtual bool IsEof() const
 	{
-		return ArPos >= DataSize;
+		return Tell() >= DataSize;
 	}
 
 	virtual void Serialize(void *data, int size)
 	{
 		guard(FMemReader::Serialize);
+		ArPos -= DropReadWindow();
 		if (ArStopper > 0 && ArPos + size > ArStopper)
 			appError("Serializing behind stopper (%X+%X > %X)", ArPos, size, ArStopper);
 		if (ArPos + size > DataSize)
 			appError("Serializing behind end of buffer");
 		memcpy(data, DataPtr + ArPos, size);
 		ArPos += size;
+		// the rest of data is available for inline reading
+		int WindowEnd = (ArStopper > 0 && ArStopper < DataSize) ? ArStopper : DataSize;
+		if (ArPos < WindowEnd)
+		{
+			ReadPtr = DataPtr + ArPos;
+			ReadEnd = DataPtr + WindowEnd;
+			ArPos = WindowEnd;
+		}
+		unguard;
+	}
+
+	virtual void SetStopper(int Pos)
+	{
+		ArPos -= DropReadWindow();
+		ArStopper = Pos;
+	}
+
+	virtual const byte* BorrowData(int64 Pos, int size)
+	{
+		if (Pos < 0 || Pos + size > DataSize) return NULL;
+		return DataPtr + Pos;
+	}
+
+	virtual void ReadAt(int64 Pos, void *data, int size)
+	{
+		guard(FMemReader::ReadAt);
+		if (Pos < 0 || Pos + size > DataSize)
+			appError("Serializing behind end of buffer");
+		memcpy(data, DataPtr + Pos, size);
 		unguard;
 	}
 
@@ -1813,9 +2037,10 @@ inline void Exchange(TArray<T>& A, TArray<T>& B)
 {
 	const int size = sizeof(TArray<T>);
 	byte buffer[size];
-	memcpy(buffer, &A, size);
-	memcpy(&A, &B, size);
-	memcpy(&B, buffer, size);
+	// arrays are relocatable, so swap them as raw memory
+	memcpy(buffer, (void*)&A, size);
+	memcpy((void*)&A, (void*)&B, size);
+	memcpy((void*)&B, buffer, size);
 }
 
 // Binary-compatible array, but with inline allocation. FArray has helper function
@@ -2332,6 +2557,10 @@ struct FIntBulkData : public FByteBulkData
 
 int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags);
 
+// Returns true when appDecompress() will modify CompressedBuffer (game-specific decryption), so
+// data borrowed from FArchive::BorrowData() can't be passed to it.
+bool appDecompressModifiesInput(int Flags);
+
 // UE4 has built-in AES encryption
 
 extern FString GAesKey;
@@ -36,6 +36,27 @@
 // AES code for UE4
 #include "rijndael/rijndael.h"
 
+// Use hardware AES instructions when supported by CPU
+#ifndef USE_AESNI
+#	if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#		define USE_AESNI	1
+#	else
+#		define USE_AESNI	0
+#	endif
+#endif
+
+#if USE_AESNI
+#	include <wmmintrin.h>				// AES-NI intrinsics
+#	if _MSC_VER
+#		include <intrin.h>				// __cpuid()
+#		define AESNI_FUNC
+#	else
+#		include <cpuid.h>				// __get_cpuid()
+		// allow intrinsics use without global compiler options
+#		define AESNI_FUNC	__attribute__((target("sse2,aes")))
+#	endif
+#endif // USE_AESNI
+
 /*-----------------------------------------------------------------------------
 	ZLib support
 -----------------------------------------------------------------------------*/
@@ -180,6 +201,23 @@ void DecryptBladeAndSoul(byte* CompressedBuffer, int CompressedSize);
 void DecryptTaoYuan(byte* CompressedBuffer, int CompressedSize);
 void DecryptDevlsThird(byte* CompressedBuffer, int CompressedSize);
 
+bool appDecompressModifiesInput(int Flags)
+{
+#if BLADENSOUL
+	if (GForceGame == GAME_BladeNSoul && Flags == COMPRESS_LZO_ENC_BNS) return true;
+#endif
+#if SMITE
+	if (GForceGame == GAME_Smite && Flags == COMPRESS_LZO_ENC_SMITE) return true;
+#endif
+#if TAO_YUAN
+	if (GForceGame == GAME_TaoYuan) return true;
+#endif
+#if DEVILS_THIRD
+	if ((GForceGame == GAME_DevilsThird) && (Flags & 8)) return true;
+#endif
+	return false;
+}
+
 int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *UncompressedBuffer, int UncompressedSize, int Flags)
 {
 	guard(appDecompress);
@@ -322,6 +360,144 @@ int appDecompress(byte *CompressedBuffer, int CompressedSize, byte *Uncompressed
 FString GAesKey;
 
 #define AES_KEYBITS		256
+#define AES_ROUNDS		14				// number of rounds for 256-bit key
+
+// Expanded key, cached between appDecryptAES() calls
+struct FAesKeySchedule
+{
+	bool			bValid;
+	bool			bUseAesNi;
+	byte			Key[KEYLENGTH(AES_KEYBITS)];
+	// rijndael code
+	unsigned long	rk[RKLENGTH(AES_KEYBITS)];
+	int				nrounds;
+#if USE_AESNI
+	// decryption round keys for AESDEC instruction
+	byte			DecKeys[AES_ROUNDS + 1][16];
+#endif
+};
+
+// Per-thread, so no locking is required when decrypting from worker threads
+static THREAD_LOCAL FAesKeySchedule GAesSchedule;
+
+#if USE_AESNI
+
+static bool CpuHasAesNi()
+{
+#if _MSC_VER
+	int Info[4];
+	__cpuid(Info, 1);
+	return (Info[2] & (1 << 25)) != 0;
+#else
+	unsigned int a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+	return (c & bit_AES) != 0;
+#endif
+}
+
+AESNI_FUNC static void SetupAesNiDecrypt(FAesKeySchedule& S, const byte* Key)
+{
+	__m128i EncKeys[AES_ROUNDS + 1];
+	__m128i t1 = _mm_loadu_si128((const __m128i*)Key);
+	__m128i t3 = _mm_loadu_si128((const __m128i*)(Key + 16));
+	__m128i t2, t4;
+	EncKeys[0] = t1;
+	EncKeys[1] = t3;
+	// AES-256 key expansion, see Intel AES-NI white paper
+#define EXPAND_KEY_1(Rcon)								\
+	t2 = _mm_aeskeygenassist_si128(t3, Rcon);			\
+	t2 = _mm_shuffle_epi32(t2, 0xFF);					\
+	t4 = _mm_slli_si128(t1, 4);							\
+	t1 = _mm_xor_si128(t1, t4);							\
+	t4 = _mm_slli_si128(t4, 4);							\
+	t1 = _mm_xor_si128(t1, t4);							\
+	t4 = _mm_slli_si128(t4, 4);							\
+	t1 = _mm_xor_si128(t1, t4);							\
+	t1 = _mm_xor_si128(t1, t2);
+#define EXPAND_KEY_2									\
+	t4 = _mm_aeskeygenassist_si128(t1, 0);				\
+	t2 = _mm_shuffle_epi32(t4, 0xAA);					\
+	t4 = _mm_slli_si128(t3, 4);							\
+	t3 = _mm_xor_si128(t3, t4);							\
+	t4 = _mm_slli_si128(t4, 4);							\
+	t3 = _mm_xor_si128(t3, t4);							\
+	t4 = _mm_slli_si128(t4, 4);							\
+	t3 = _mm_xor_si128(t3, t4);							\
+	t3 = _mm_xor_si128(t3, t2);
+	EXPAND_KEY_1(0x01) EncKeys[2]  = t1; EXPAND_KEY_2 EncKeys[3]  = t3;
+	EXPAND_KEY_1(0x02) EncKeys[4]  = t1; EXPAND_KEY_2 EncKeys[5]  = t3;
+	EXPAND_KEY_1(0x04) EncKeys[6]  = t1; EXPAND_KEY_2 EncKeys[7]  = t3;
+	EXPAND_KEY_1(0x08) EncKeys[8]  = t1; EXPAND_KEY_2 EncKeys[9]  = t3;
+	EXPAND_KEY_1(0x10) EncKeys[10] = t1; EXPAND_KEY_2 EncKeys[11] = t3;
+	EXPAND_KEY_1(0x20) EncKeys[12] = t1; EXPAND_KEY_2 EncKeys[13] = t3;
+	EXPAND_KEY_1(0x40) EncKeys[14] = t1;
+#undef EXPAND_KEY_1
+#undef EXPAND_KEY_2
+	// convert to decryption keys (Equivalent Inverse Cipher)
+	_mm_storeu_si128((__m128i*)S.DecKeys[0], EncKeys[AES_ROUNDS]);
+	for (int i = 1; i < AES_ROUNDS; i++)
+		_mm_storeu_si128((__m128i*)S.DecKeys[i], _mm_aesimc_si128(EncKeys[AES_ROUNDS - i]));
+	_mm_storeu_si128((__m128i*)S.DecKeys[AES_ROUNDS], EncKeys[0]);
+}
+
+AESNI_FUNC static void DecryptAesNi(const FAesKeySchedule& S, byte* Data, int Size)
+{
+	__m128i Keys[AES_ROUNDS + 1];
+	for (int i = 0; i <= AES_ROUNDS; i++)
+		Keys[i] = _mm_loadu_si128((const __m128i*)S.DecKeys[i]);
+
+	__m128i* p = (__m128i*)Data;
+	int NumBlocks = Size / 16;
+	int i = 0;
+	// process 4 blocks at once to hide latency of AESDEC
+	for ( ; i + 4 <= NumBlocks; i += 4)
+	{
+		__m128i b0 = _mm_xor_si128(_mm_loadu_si128(p + i    ), Keys[0]);
+		__m128i b1 = _mm_xor_si128(_mm_loadu_si128(p + i + 1), Keys[0]);
+		__m128i b2 = _mm_xor_si128(_mm_loadu_si128(p + i + 2), Keys[0]);
+		__m128i b3 = _mm_xor_si128(_mm_loadu_si128(p + i + 3), Keys[0]);
+		for (int r = 1; r < AES_ROUNDS; r++)
+		{
+			b0 = _mm_aesdec_si128(b0, Keys[r]);
+			b1 = _mm_aesdec_si128(b1, Keys[r]);
+			b2 = _mm_aesdec_si128(b2, Keys[r]);
+			b3 = _mm_aesdec_si128(b3, Keys[r]);
+		}
+		_mm_storeu_si128(p + i,     _mm_aesdeclast_si128(b0, Keys[AES_ROUNDS]));
+		_mm_storeu_si128(p + i + 1, _mm_aesdeclast_si128(b1, Keys[AES_ROUNDS]));
+		_mm_storeu_si128(p + i + 2, _mm_aesdeclast_si128(b2, Keys[AES_ROUNDS]));
+		_mm_storeu_si128(p + i + 3, _mm_aesdeclast_si128(b3, Keys[AES_ROUNDS]));
+	}
+	for ( ; i < NumBlocks; i++)
+	{
+		__m128i b = _mm_xor_si128(_mm_loadu_si128(p + i), Keys[0]);
+		for (int r = 1; r < AES_ROUNDS; r++)
+			b = _mm_aesdec_si128(b, Keys[r]);
+		_mm_storeu_si128(p + i, _mm_aesdeclast_si128(b, Keys[AES_ROUNDS]));
+	}
+}
+
+#endif // USE_AESNI
+
+static const FAesKeySchedule& GetAesKeySchedule(const char* Key)
+{
+	FAesKeySchedule& S = GAesSchedule;
+	if (S.bValid && !memcmp(S.Key, Key, sizeof(S.Key)))
+		return S;
+
+	memcpy(S.Key, Key, sizeof(S.Key));
+#if USE_AESNI
+	static int HasAesNi = -1;			// not checked yet
+	if (HasAesNi < 0) HasAesNi = CpuHasAesNi();
+	S.bUseAesNi = (HasAesNi != 0);
+	if (S.bUseAesNi)
+		SetupAesNiDecrypt(S, S.Key);
+	else
+#endif
+		S.nrounds = rijndaelSetupDecrypt(S.rk, S.Key, AES_KEYBITS);
+	S.bValid = true;
+	return S;
+}
 
 void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen)
 {
@@ -343,12 +519,19 @@ void appDecryptAES(byte* Data, int Size, const char* Key, int KeyLen)
 
 	assert((Size & 15) == 0);
 
-	unsigned long rk[RKLENGTH(AES_KEYBITS)];
-	int nrounds = rijndaelSetupDecrypt(rk, (const byte*)Key, AES_KEYBITS);
+	const FAesKeySchedule& Schedule = GetAesKeySchedule(Key);
+
+#if USE_AESNI
+	if (Schedule.bUseAesNi)
+	{
+		DecryptAesNi(Schedule, Data, Size);
+		return;
+	}
+#endif
 
 	for (int pos = 0; pos < Size; pos += 16)
 	{
-		rijndaelDecrypt(rk, nrounds, Data + pos, Data + pos);
+		rijndaelDecrypt(Schedule.rk, Schedule.nrounds, Data + pos, Data + pos);
 	}
 
 	unguard;
@@ -4,13 +4,37 @@
 #if UNREAL4
 #include "UnPackage.h"			// for accessing FPackageFileSummary from FByteBulkData
 #endif
+#include "Parallel.h"			// for profiler counters
 
 #if _WIN32
 #include <io.h>					// for _filelengthi64
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>			// for CreateFileMapping()
+#else
+#include <sys/mman.h>			// for mmap()
+#include <fcntl.h>				// for posix_fadvise()
+#include <unistd.h>				// for pread()
+#include <errno.h>
+#endif
+
+// SIMD byte swapping. SSE2 is available on all x86-64 CPUs and is enabled for 32-bit builds; PSHUFB
+// is used when the compiler targets SSSE3.
+#if __SSSE3__
+#include <tmmintrin.h>
+#define USE_SSE_BYTESWAP		1
+#elif __SSE2__ || _M_X64 || (_M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE_BYTESWAP		1
 #endif
 
 
 #define FILE_BUFFER_SIZE		4096
+#define FILE_BUFFER_MAX_SIZE	(1024*1024)		// limit for adaptive read-ahead of FFileReader
+
+// Files larger than this value are read with buffered I/O instead of being mapped to memory. 32-bit
+// process has too small address space for mapping large pak files.
+#define MAX_MAPPED_FILE_SIZE	(sizeof(void*) >= 8 ? (1LL << 40) : (256LL << 20))
 
 
 //#define DEBUG_BULK			1
@@ -156,8 +180,93 @@ void SkipLazyArray(FArchive &Ar)
 	unguard;
 }
 
+#if USE_SSE_BYTESWAP
+
+// Reverse bytes of every ItemSize-byte item in the vector
+template<int ItemSize>
+static FORCEINLINE __m128i ReverseVectorBytes(__m128i v)
+{
+#if __SSSE3__
+	const __m128i Mask = (ItemSize == 2)
+		? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+		: (ItemSize == 4)
+		? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+		: _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	return _mm_shuffle_epi8(v, Mask);
+#else
+	// reverse order of 16-bit words in item, then swap bytes in words
+	if (ItemSize == 4)
+	{
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	}
+	else if (ItemSize == 8)
+	{
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	}
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+#endif // __SSSE3__
+}
+
+#endif // USE_SSE_BYTESWAP
+
+template<int ItemSize>
+static void ReverseItemBytes(byte* Data, int NumItems)
+{
+#if USE_SSE_BYTESWAP
+	// 16 bytes per iteration
+	int NumVectors = NumItems * ItemSize / 16;
+	for (int i = 0; i < NumVectors; i++, Data += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)Data);
+		_mm_storeu_si128((__m128i*)Data, ReverseVectorBytes<ItemSize>(v));
+	}
+	NumItems -= NumVectors * 16 / ItemSize;
+#endif // USE_SSE_BYTESWAP
+	for (int i = 0; i < NumItems; i++, Data += ItemSize)
+	{
+		if (ItemSize == 2)
+		{
+			uint16 v;
+			memcpy(&v, Data, 2);
+			v = BSWAP16(v);
+			memcpy(Data, &v, 2);
+		}
+		else if (ItemSize == 4)
+		{
+			uint32 v;
+			memcpy(&v, Data, 4);
+			v = BSWAP32(v);
+			memcpy(Data, &v, 4);
+		}
+		else
+		{
+			uint64 v;
+			memcpy(&v, Data, 8);
+			v = BSWAP64(v);
+			memcpy(Data, &v, 8);
+		}
+	}
+}
+
 void appReverseBytes(void *Block, int NumItems, int ItemSize)
 {
+	switch (ItemSize)
+	{
+	case 1:
+		return;
+	case 2:
+		ReverseItemBytes<2>((byte*)Block, NumItems);
+		return;
+	case 4:
+		ReverseItemBytes<4>((byte*)Block, NumItems);
+		return;
+	case 8:
+		ReverseItemBytes<8>((byte*)Block, NumItems);
+		return;
+	}
+
 	byte *p1 = (byte*)Block;
 	byte *p2 = p1 + ItemSize - 1;
 	for (int i = 0; i < NumItems; i++, p1 += ItemSize, p2 += ItemSize)
@@ -434,14 +543,7 @@ void FArchive::ByteOrderSerialize(void *data, int size)
 	if (!ReverseBytes || size <= 1) return;
 
 	assert(IsLoading);
-	byte *p1 = (byte*)data;
-	byte *p2 = p1 + size - 1;
-	while (p1 < p2)
-	{
-		Exchange(*p1, *p2);
-		p1++;
-		p2--;
-	}
+	appReverseBytes(data, 1, size);
 
 	unguard;
 }
@@ -497,6 +599,10 @@ FFileArchive::FFileArchive(const char *Filename, unsigned InOptions)
 ,	BufferPos(0)
 ,	BufferSize(0)
 ,	ArPos64(0)
+,	MappedData(NULL)
+#if _WIN32
+,	MappingHandle(NULL)
+#endif
 {
 	// process the filename
 	FullName = appStrdup(Filename);
@@ -555,9 +661,10 @@ void FFileArchive::Close()
 {
 	if (IsOpen())
 	{
+		UnmapFile();
 		fclose(f);
 		f = NULL;
-		appFree(Buffer);
+		if (Buffer) appFree(Buffer);
 		Buffer = NULL;
 	}
 }
@@ -590,8 +697,63 @@ bool FFileArchive::OpenFile()
 	unguard;
 }
 
+// Map the whole opened file to memory. Returns false when mapping is not possible, so
+// buffered reading should be used.
+bool FFileArchive::MapFile()
+{
+	guard(FFileArchive::MapFile);
+	assert(IsOpen() && !MappedData);
+
+	// FileSize is computed lazily, so get it now
+	int64 Size = GetFileSize64();
+	if (Size <= 0 || Size > MAX_MAPPED_FILE_SIZE)
+		return false;			// empty file can't be mapped, large file doesn't fit address space
+
+#if _WIN32
+	HANDLE hFile = (HANDLE)_get_osfhandle(fileno(f));
+	HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!hMapping) return false;
+	void* Data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!Data)
+	{
+		CloseHandle(hMapping);
+		return false;
+	}
+	MappingHandle = hMapping;
+#else
+	void* Data = mmap(NULL, (size_t)Size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+	if (Data == MAP_FAILED) return false;
+#endif // _WIN32
+
+	MappedData = (byte*)Data;
+	// buffer is not needed anymore
+	if (Buffer) appFree(Buffer);
+	Buffer = NULL;
+	return true;
+
+	unguardf("%s", ShortName);
+}
+
+void FFileArchive::UnmapFile()
+{
+	if (!MappedData) return;
+#if _WIN32
+	UnmapViewOfFile(MappedData);
+	CloseHandle(MappingHandle);
+	MappingHandle = NULL;
+#else
+	munmap(const_cast<byte*>(MappedData), (size_t)FileSize);
+#endif
+	MappedData = NULL;
+}
+
 FFileReader::FFileReader(const char *Filename, unsigned InOptions)
 :	FFileArchive(Filename, InOptions)
+,	BufferCapacity(FILE_BUFFER_SIZE)
+,	ReadAheadHint(0)
+#if _WIN32
+,	OverlappedHandle(NULL)
+#endif
 {
 	guard(FFileReader::FFileReader);
 	IsLoading = true;
@@ -608,14 +770,38 @@ void FFileReader::Serialize(void *data, int size)
 {
 	guard(FFileReader::Serialize);
 
+	ArPos64 -= DropReadWindow();
+
 	if (ArStopper > 0 && ArPos64 + size > ArStopper)
 		appError("Serializing behind stopper (%llX+%X > %X)", ArPos64, size, ArStopper);
 
+	if (MappedData)
+	{
+		// whole file is in memory
+		if (ArPos64 < 0 || ArPos64 + size > FileSize)
+			appError("Unable to read %d bytes at pos=0x%llX", size, ArPos64);
+		memcpy(data, MappedData + ArPos64, size);
+		ArPos64 += size;
+		SetupReadWindow();
+		return;
+	}
+
+#if PROFILE
+	bool BufferHit = true;
+#endif
+
 	while (size > 0)
 	{
 		int64 LocalPos64 = ArPos64 - BufferPos;
 		if (LocalPos64 < 0 || LocalPos64 >= BufferSize)
 		{
+		#if PROFILE
+			BufferHit = false;
+		#endif
+			// large blocks bypass the buffer, so they shouldn't affect its size
+			bool DirectRead = (size >= BufferCapacity);
+			// adjust buffer size to the access pattern
+			if (!DirectRead) UpdateReadAhead();
 			// seek to desired position if needed
 			if (ArPos64 != FilePos)
 			{
@@ -624,27 +810,30 @@ void FFileReader::Serialize(void *data, int size)
 				FilePos = ArPos64;
 			}
 			// the requested data is not in buffer
-			if (size >= FILE_BUFFER_SIZE)
+			if (DirectRead)
 			{
 				// large block, read directly from file
 				int res = fread(data, size, 1, f);
 				if (res != 1)
 					appError("Unable to read %d bytes at pos=0x%llX", size, ArPos64);
 			#if PROFILE
-				GNumSerialize++;
-				GSerializeBytes += size;
+				appInterlockedIncrement(&GNumSerialize);
+				appInterlockedAdd(&GSerializeBytes, size);
 			#endif
 				ArPos64 += size;
 				FilePos += size;
+				// move the empty buffer to the new file position, so the next read will be seen as sequential
+				BufferPos = FilePos;
+				BufferSize = 0;
 				return;
 			}
 			// fill buffer
-			int ReadBytes = fread(Buffer, 1, FILE_BUFFER_SIZE, f);
+			int ReadBytes = fread(Buffer, 1, BufferCapacity, f);
 			if (ReadBytes == 0)
 				appError("Unable to read %d bytes at pos=0x%llX", 1, ArPos64);
 		#if PROFILE
-			GNumSerialize++;
-			GSerializeBytes += ReadBytes;
+			appInterlockedIncrement(&GNumSerialize);
+			appInterlockedAdd(&GSerializeBytes, ReadBytes);
 		#endif
 			BufferPos = FilePos;
 			BufferSize = ReadBytes;
@@ -666,12 +855,188 @@ void FFileReader::Serialize(void *data, int size)
 		ArPos64 += CanCopy;
 	}
 
+#if PROFILE
+	if (BufferHit) appInterlockedIncrement(&GNumBufferHits);
+#endif
+
+	SetupReadWindow();
+
 	unguardf("File=%s", ShortName);
 }
 
+// Expose mapped file or buffer data after the current position to inline serializers
+void FFileReader::SetupReadWindow()
+{
+	const byte* Data = MappedData ? MappedData : Buffer;
+	int64 DataPos = MappedData ? 0 : BufferPos;
+	int64 DataEnd = DataPos + (MappedData ? FileSize : BufferSize);
+	if (ArStopper > 0 && ArStopper < DataEnd) DataEnd = ArStopper;
+	if (ArPos64 < DataPos || ArPos64 >= DataEnd) return;
+	ReadPtr = Data + (ArPos64 - DataPos);
+	ReadEnd = Data + (DataEnd - DataPos);
+	ArPos64 = DataEnd;
+}
+
+void FFileReader::Seek(int Pos)
+{
+	DropReadWindow();
+	ArPos64 = Pos;
+}
+
+void FFileReader::Seek64(int64 Pos)
+{
+	DropReadWindow();
+	ArPos64 = Pos;
+}
+
+int FFileReader::Tell() const
+{
+	return (int)Tell64();
+}
+
+int64 FFileReader::Tell64() const
+{
+	return ArPos64 - (ReadEnd - ReadPtr);
+}
+
+bool FFileReader::IsEof() const
+{
+	return Tell64() >= GetFileSize64();
+}
+
+void FFileReader::SetStopper(int Pos)
+{
+	ArPos64 -= DropReadWindow();
+	ArStopper = Pos;
+}
+
+// Called when requested data is not in the buffer. When reading continues near the place where the
+// previous read has finished, the file is read sequentially, so the buffer is doubled to read more
+// data ahead. Otherwise the buffer is shrunk to not waste time on reading data which won't be used.
+void FFileReader::UpdateReadAhead()
+{
+	int NewCapacity;
+	if (ArPos64 >= FilePos && ArPos64 < FilePos + BufferCapacity)
+		NewCapacity = min(BufferCapacity * 2, FILE_BUFFER_MAX_SIZE);
+	else
+		NewCapacity = max(BufferCapacity / 2, FILE_BUFFER_SIZE);
+
+	if (NewCapacity != BufferCapacity)
+	{
+		// buffer contents will be replaced anyway, so don't copy the data
+		appFree(Buffer);
+		Buffer = (byte*)appMalloc(NewCapacity);
+		BufferCapacity = NewCapacity;
+		BufferPos = BufferSize = 0;
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	// let the OS know about access pattern, so it will adjust its own read-ahead
+	int Hint = POSIX_FADV_NORMAL;
+	if (BufferCapacity == FILE_BUFFER_MAX_SIZE)
+		Hint = POSIX_FADV_SEQUENTIAL;
+	else if (BufferCapacity == FILE_BUFFER_SIZE)
+		Hint = POSIX_FADV_RANDOM;
+	if (Hint != ReadAheadHint)
+	{
+		posix_fadvise(fileno(f), 0, 0, Hint);
+		ReadAheadHint = Hint;
+	}
+#endif // POSIX_FADV_SEQUENTIAL
+}
+
+const byte* FFileReader::BorrowData(int64 Pos, int size)
+{
+	if (!MappedData || Pos < 0 || Pos + size > FileSize)
+		return NULL;
+	return MappedData + Pos;
+}
+
+// Doesn't use the buffer and file position, so several threads could read the same file simultaneously.
+void FFileReader::ReadAt(int64 Pos, void *data, int size)
+{
+	guard(FFileReader::ReadAt);
+
+	if (MappedData)
+	{
+		if (Pos < 0 || Pos + size > FileSize)
+			appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+		memcpy(data, MappedData + Pos, size);
+		return;
+	}
+
+	assert(f);
+#if _WIN32
+	// Reading from the CRT file handle would move its file pointer, so use a separate handle opened
+	// for asynchronous i/o: it has no file pointer at all
+	HANDLE File = (HANDLE)OverlappedHandle;
+	if (!File)
+	{
+		static CSpinLock OpenLock;
+		TScopeLock<CSpinLock> Lock(OpenLock);
+		File = (HANDLE)OverlappedHandle;
+		if (!File)
+		{
+			File = CreateFileA(FullName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+				OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+			if (File == INVALID_HANDLE_VALUE)
+				appError("Unable to open file %s", FullName);
+			appInterlockedExchangePtr(&OverlappedHandle, File);
+		}
+	}
+	// one event per thread, not released
+	static THREAD_LOCAL HANDLE ReadEvent = NULL;
+	if (!ReadEvent) ReadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	OVERLAPPED Overlapped;
+	memset(&Overlapped, 0, sizeof(Overlapped));
+	Overlapped.Offset = (DWORD)Pos;
+	Overlapped.OffsetHigh = (DWORD)(Pos >> 32);
+	Overlapped.hEvent = ReadEvent;
+	DWORD BytesRead = 0;
+	if (!ReadFile(File, data, size, NULL, &Overlapped) && GetLastError() != ERROR_IO_PENDING)
+		appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+	if (!GetOverlappedResult(File, &Overlapped, &BytesRead, TRUE) || BytesRead != size)
+		appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+#else
+	int fd = fileno(f);
+	while (size > 0)
+	{
+		ssize_t ReadBytes = pread64(fd, data, size, Pos);
+		if (ReadBytes < 0 && errno == EINTR) continue;
+		if (ReadBytes <= 0)
+			appError("Unable to read %d bytes at pos=0x%llX", size, Pos);
+		data = OffsetPointer(data, (int)ReadBytes);
+		size -= ReadBytes;
+		Pos += ReadBytes;
+	}
+#endif // _WIN32
+
+	unguardf("File=%s", ShortName);
+}
+
+void FFileReader::Close()
+{
+	// window points to the buffer or mapped data
+	ArPos64 -= DropReadWindow();
+#if _WIN32
+	if (OverlappedHandle)
+	{
+		CloseHandle((HANDLE)OverlappedHandle);
+		OverlappedHandle = NULL;
+	}
+#endif
+	FFileArchive::Close();
+}
+
 bool FFileReader::Open()
 {
-	return OpenFile();
+	if (!OpenFile()) return false;
+	// OpenFile() allocates the buffer of default size
+	BufferCapacity = FILE_BUFFER_SIZE;
+	ReadAheadHint = 0;
+	if (!(Options & (FAO_NoMemoryMap|FAO_TextFile)))
+		MapFile();				// fall back to buffered reading when failed
+	return true;
 }
 
 int64 FFileReader::GetFileSize64() const
@@ -755,8 +1120,8 @@ void FFileWriter::Serialize(void *data, int size)
 				if (res != 1)
 					appError("Unable to write %d bytes at pos=0x%llX", size, ArPos64);
 			#if PROFILE
-				GNumSerialize++;
-				GSerializeBytes += size;
+				appInterlockedIncrement(&GNumSerialize);
+				appInterlockedAdd(&GSerializeBytes, size);
 			#endif
 				ArPos64 += size;
 				FilePos += size;
@@ -812,8 +1177,8 @@ void FFileWriter::FlushBuffer()
 		if (res != 1)
 			appError("Unable to write %d bytes at pos=0x%llX", BufferSize, ArPos64);
 #if PROFILE
-		GNumSerialize++;
-		GSerializeBytes += BufferSize;
+		appInterlockedIncrement(&GNumSerialize);
+		appInterlockedAdd(&GSerializeBytes, BufferSize);
 #endif
 		FilePos += BufferSize;
 		BufferSize = 0;
@@ -959,21 +1324,34 @@ void appReadCompressedChunk(FArchive &Ar, byte *Buffer, int Size, int Compressio
 	Ar << ChunkHeader;
 	// prepare buffer for reading compressed data
 	int BufferSize = ChunkHeader.BlockSize * 16;
-	byte *ReadBuffer = (byte*)appMalloc(BufferSize);	// BlockSize is size of uncompressed data
+	byte *ReadBuffer = NULL;
+	bool CanBorrow = !appDecompressModifiesInput(CompressionFlags);
 	// read and decompress data
 	for (int BlockIndex = 0; BlockIndex < ChunkHeader.Blocks.Num(); BlockIndex++)
 	{
 		const FCompressedChunkBlock *Block = &ChunkHeader.Blocks[BlockIndex];
 		assert(Block->CompressedSize <= BufferSize);
 		assert(Block->UncompressedSize <= Size);
-		Ar.Serialize(ReadBuffer, Block->CompressedSize);
-		appDecompress(ReadBuffer, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
+		// decompress directly from memory-mapped file when possible
+		int64 BlockPos = Ar.Tell64();
+		const byte *BlockData = CanBorrow ? Ar.BorrowData(BlockPos, Block->CompressedSize) : NULL;
+		if (BlockData)
+		{
+			Ar.Seek64(BlockPos + Block->CompressedSize);
+		}
+		else
+		{
+			if (!ReadBuffer) ReadBuffer = (byte*)appMalloc(BufferSize);	// BlockSize is size of uncompressed data
+			Ar.Serialize(ReadBuffer, Block->CompressedSize);
+			BlockData = ReadBuffer;
+		}
+		appDecompress(const_cast<byte*>(BlockData), Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
 		Size   -= Block->UncompressedSize;
 		Buffer += Block->UncompressedSize;
 	}
 	// finalize
 	assert(Size == 0);			// should be comletely read
-	delete ReadBuffer;
+	if (ReadBuffer) appFree(ReadBuffer);
 	unguard;
 }
 
@@ -94,10 +94,11 @@ struct FPositionVertexBuffer4
 	}
 };
 
+// thread-local, because objects could be serialized by several threads at once
 //?? TODO: rename, because these vars are now used for both mesh types
-static int  GNumStaticUVSets   = 1;
-static bool GUseStaticFloatUVs = true;
-static bool GUseHighPrecisionTangents = false;
+static THREAD_LOCAL int  GNumStaticUVSets   = 1;
+static THREAD_LOCAL bool GUseStaticFloatUVs = true;
+static THREAD_LOCAL bool GUseHighPrecisionTangents = false;
 
 struct FStaticMeshUVItem4
 {
@@ -271,7 +272,7 @@ struct FOverlappingVerticesCustomVersion
 	}
 };
 
-static int GNumSkelInfluences = 4;
+static THREAD_LOCAL int GNumSkelInfluences = 4;
 
 // Bone influence mapping for skeletal mesh vertex
 struct FSkinWeightInfo
@@ -397,7 +398,7 @@ struct FRigidVertex4 : public FSoftVertex4
 	}
 };
 
-static int GNumSkelUVSets = 1;
+static THREAD_LOCAL int GNumSkelUVSets = 1;
 
 // GPU vertex with float16 UV data
 struct FGPUVert4Half : public FSkelMeshVertexBase
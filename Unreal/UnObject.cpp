@@ -4,6 +4,7 @@
 #include "UnPackage.h"
 
 #include "GameDatabase.h"		// for GetGameTag()
+#include "Parallel.h"
 
 
 //#define DEBUG_PROPS				1
@@ -134,7 +135,7 @@ int UObject::GetLicenseeVer() const
 int              UObject::GObjBeginLoadCount = 0;
 TArray<UObject*> UObject::GObjLoaded;
 TArray<UObject*> UObject::GObjObjects;
-UObject         *UObject::GLoadingObj = NULL;
+THREAD_LOCAL UObject *UObject::GLoadingObj = NULL;
 
 
 void UObject::BeginLoad()
@@ -144,6 +145,97 @@ void UObject::BeginLoad()
 }
 
 
+// Item of the loading queue used in UObject::EndLoad()
+struct CObjectLoadItem
+{
+	UObject*	Obj;
+	int			PackageRank;					// packages are ordered by appearance in the queue
+	int			SerialOffset;
+	int			Order;							// position in the queue, makes sorting stable
+};
+
+static int CompareObjectLoadItems(const CObjectLoadItem& A, const CObjectLoadItem& B)
+{
+	if (A.PackageRank != B.PackageRank) return A.PackageRank - B.PackageRank;
+	if (A.SerialOffset != B.SerialOffset) return (A.SerialOffset < B.SerialOffset) ? -1 : 1;
+	return A.Order - B.Order;
+}
+
+// Order of objects which doesn't depend on order of their creation
+static int CompareObjectsByPackage(UObject* const& A, UObject* const& B)
+{
+	if (A->Package != B->Package) return strcmp(A->Package->Filename, B->Package->Filename);
+	return A->PackageIndex - B->PackageIndex;
+}
+
+// Range of CObjectLoadItem's from a single package, loaded by one thread with its own reader
+struct CObjectLoadChunk
+{
+	int			First;
+	int			Count;
+};
+
+// Max number of objects in a CObjectLoadChunk. Small chunks are better for distributing work
+// between threads, large ones - for sequential reading from the package file.
+#define LOAD_CHUNK_SIZE		8
+
+static void LoadObject(UObject* Obj)
+{
+	UnPackage *Package = Obj->Package;
+	guard(LoadObject);
+	Package->SetupReader(Obj->PackageIndex);
+	// setup NotifyInfo to describe object
+	appSetNotifyHeader("Loading object %s'%s.%s'", Obj->GetClassName(), Package->Name, Obj->Name);
+#if PROFILE_LOADING
+	appResetProfiler();
+#endif
+	UObject::GLoadingObj = Obj;
+	Obj->Serialize(*Package);
+	UObject::GLoadingObj = NULL;
+#if PROFILE_LOADING
+	appPrintProfiler();
+#endif
+	// check for unread bytes
+	if (!Package->IsStopper())
+		appError("%s::Serialize(%s): %d unread bytes",
+			Obj->GetClassName(), Obj->Name,
+			Package->GetStopper() - Package->Tell());
+	Package->ReleaseReader();
+
+#if UNREAL4
+	#define UNVERS_STR		(Package->Game >= GAME_UE4_BASE && Package->Summary.IsUnversioned) ? " (unversioned)" : ""
+#else
+	#define UNVERS_STR		""
+#endif
+
+	unguardf("%s'%s.%s', pos=%X, ver=%d/%d%s, game=%s", Obj->GetClassName(), Package->Name, Obj->Name, Package->Tell(),
+		Package->ArVer, Package->ArLicenseeVer, UNVERS_STR, GetGameTag(Package->Game));
+}
+
+static void LoadObjectChunk(const TArray<CObjectLoadItem>& Items, const CObjectLoadChunk& Chunk)
+{
+	UnPackage* Package = Items[Chunk.First].Obj->Package;
+	FArchive* Reader = Package->AcquireExportReader();
+	assert(Reader);
+	// package is shared with other threads, it should not have the read window of its main loader
+	assert(!Package->ReadPtr);
+	Package->SetThreadLoader(Reader);
+	bool Failed = false;
+	TRY
+	{
+		for (int i = Chunk.First; i < Chunk.First + Chunk.Count; i++)
+			LoadObject(Items[i].Obj);
+	}
+	CATCH
+	{
+		Failed = true;
+	}
+	Package->SetThreadLoader(NULL);
+	Package->ReleaseExportReader(Reader);
+	if (Failed)
+		appRaiseErrorHistory(GErrorHistory);
+}
+
 void UObject::EndLoad()
 {
 	assert(GObjBeginLoadCount > 0);
@@ -155,44 +247,107 @@ void UObject::EndLoad()
 
 	guard(UObject::EndLoad);
 
-	// process GObjLoaded array
-	// NOTE: while loading one array element, array may grow!
+	// Process GObjLoaded array. Objects created while loading are added to GObjLoaded, so the queue
+	// is processed in batches. Each batch is grouped by package and sorted by position in the package
+	// file, so package data is read sequentially. When possible, objects are serialized by several
+	// threads. LoadedObjects has the same order as the queue, which is used for PostLoad() calls.
 	TArray<UObject*> LoadedObjects;
+	TArray<UObject*> Batch;
+	TArray<CObjectLoadItem> Items;
+	TArray<UnPackage*> BatchPackages;
+	TArray<bool> ParallelPackages;
+	TArray<CObjectLoadChunk> Chunks;
 	while (GObjLoaded.Num())
 	{
-		UObject *Obj = GObjLoaded[0];
-		GObjLoaded.RemoveAt(0);
-		//!! should sort by packages + package offset
-		UnPackage *Package = Obj->Package;
-		guard(LoadObject);
-		Package->SetupReader(Obj->PackageIndex);
-		appPrintf("Loading %s %s from package %s\n", Obj->GetClassName(), Obj->Name, Package->Filename);
-		// setup NotifyInfo to describe object
-		appSetNotifyHeader("Loading object %s'%s.%s'", Obj->GetClassName(), Package->Name, Obj->Name);
-#if PROFILE_LOADING
-		appResetProfiler();
-#endif
-		GLoadingObj = Obj;
-		Obj->Serialize(*Package);
-		GLoadingObj = NULL;
-#if PROFILE_LOADING
-		appPrintProfiler();
-#endif
-		// check for unread bytes
-		if (!Package->IsStopper())
-			appError("%s::Serialize(%s): %d unread bytes",
-				Obj->GetClassName(), Obj->Name,
-				Package->GetStopper() - Package->Tell());
-		LoadedObjects.Add(Obj);
-
+		Exchange(Batch, GObjLoaded);
+		GObjLoaded.Empty();
+
+		Items.Empty(Batch.Num());
+		BatchPackages.Empty();
+		ParallelPackages.Empty();
+		int PackageRank = -1;
+		for (int i = 0; i < Batch.Num(); i++)
+		{
+			UObject* Obj = Batch[i];
+			LoadedObjects.Add(Obj);
+			if (PackageRank < 0 || BatchPackages[PackageRank] != Obj->Package)
+			{
+				PackageRank = BatchPackages.FindItem(Obj->Package);
+				if (PackageRank < 0)
+				{
+					PackageRank = BatchPackages.Add(Obj->Package);
+					// UE4 object serializers don't use global state, so objects from UE4 packages could be
+					// loaded in parallel when we could open more readers for the package
 #if UNREAL4
-	#define UNVERS_STR		(Package->Game >= GAME_UE4_BASE && Package->Summary.IsUnversioned) ? " (unversioned)" : ""
+					ParallelPackages.Add((Obj->Package->Game >= GAME_UE4_BASE) && Obj->Package->CanCreateExportReader());
 #else
-	#define UNVERS_STR		""
+					ParallelPackages.Add(false);
 #endif
+				}
+			}
+			CObjectLoadItem* Item = new (Items) CObjectLoadItem;
+			Item->Obj = Obj;
+			Item->PackageRank = PackageRank;
+			Item->SerialOffset = Obj->Package->GetExport(Obj->PackageIndex).SerialOffset;
+			Item->Order = i;
+		}
+		Items.Sort(CompareObjectLoadItems);
 
-		unguardf("%s'%s.%s', pos=%X, ver=%d/%d%s, game=%s", Obj->GetClassName(), Package->Name, Obj->Name, Package->Tell(),
-			Package->ArVer, Package->ArLicenseeVer, UNVERS_STR, GetGameTag(Package->Game));
+		// Split objects which could be loaded in parallel into chunks
+		Chunks.Empty();
+		for (int i = 0; i < Items.Num(); i++)
+		{
+			int Rank = Items[i].PackageRank;
+			if (!ParallelPackages[Rank]) continue;
+			CObjectLoadChunk* Chunk = (Chunks.Num()) ? &Chunks[Chunks.Num() - 1] : NULL;
+			if (!Chunk || Items[Chunk->First].PackageRank != Rank || Chunk->Count >= LOAD_CHUNK_SIZE)
+			{
+				Chunk = new (Chunks) CObjectLoadChunk;
+				Chunk->First = i;
+				Chunk->Count = 0;
+			}
+			Chunk->Count++;
+		}
+		// Use the package's own reader when there's nothing to parallelize
+		bool bParallel = (Chunks.Num() > 1);
+
+		if (bParallel)
+		{
+			// Worker threads will create objects referenced from the loaded ones. Load imported packages
+			// here, so PackageMap order and log doesn't depend on timing.
+			for (int i = 0; i < BatchPackages.Num(); i++)
+			{
+				if (ParallelPackages[i])
+					BatchPackages[i]->LoadImportPackages();
+			}
+			// Print messages before starting threads, so the log doesn't depend on timing
+			for (int i = 0; i < Items.Num(); i++)
+			{
+				UObject* Obj = Items[i].Obj;
+				if (!ParallelPackages[Items[i].PackageRank]) continue;
+				appPrintf("Loading %s %s from package %s\n", Obj->GetClassName(), Obj->Name, Obj->Package->Filename);
+				// package's read window could be left by reading from this thread
+				Obj->Package->ReleaseReader();
+			}
+			int FirstNewObject = GObjObjects.Num();
+			ParallelFor(Chunks.Num(), [&Items, &Chunks](int i)
+				{
+					LoadObjectChunk(Items, Chunks[i]);
+				});
+			// Objects referenced from loaded ones were created by worker threads in random order,
+			// sort them to make the result independent of timing
+			QSort(GObjObjects.GetData() + FirstNewObject, GObjObjects.Num() - FirstNewObject, CompareObjectsByPackage);
+			GObjLoaded.Sort(CompareObjectsByPackage);
+		}
+
+		// Load remaining objects in this thread
+		for (int i = 0; i < Items.Num(); i++)
+		{
+			if (bParallel && ParallelPackages[Items[i].PackageRank]) continue;
+			UObject* Obj = Items[i].Obj;
+			appPrintf("Loading %s %s from package %s\n", Obj->GetClassName(), Obj->Name, Obj->Package->Filename);
+			LoadObject(Obj);
+		}
 	}
 	// postload objects
 	int i;
@@ -406,7 +561,7 @@ struct FPropertyTag
 				Ar << Object;
 				if (!Object)
 				{
-					Tag.Name.Str = "None";
+					Tag.Name.Str = GNoneName;
 					return Ar;
 				}
 				// now, should continue serialization, skipping Name serialization (not implemented right now, so - appError)
@@ -608,7 +763,7 @@ struct FPropertyTagBat2
 		{
 		simple_prop:
 			// property serialized by offset
-			Tag.PropertyName.Str = "None";
+			Tag.PropertyName.Str = GNoneName;
 			Tag.DataSize = Tag.ArrayIndex = 0;
 			return Ar;
 		}
@@ -740,7 +895,7 @@ static bool FindPropBat2(const CTypeInfo *StrucType, const FPropertyTagBat2 &Tag
 
 	// prepare Tag
 	Tag.Type       = TagBat.Type;
-	Tag.Name.Str   = "unk";
+	Tag.Name       = "unk";
 	Tag.DataSize   = 0;			// unset
 	Tag.ArrayIndex = 0;
 
@@ -775,7 +930,7 @@ static bool FindPropBat2(const CTypeInfo *StrucType, const FPropertyTagBat2 &Tag
 			if (p->Offset == TagBat.Offset)
 			{
 				// found it
-				Tag.Name.Str   = p->Name;
+				Tag.Name       = p->Name;
 				Tag.Type       = TagBat.Type;
 				Tag.DataSize   = 0;			// unset
 				Tag.ArrayIndex = 0;
@@ -886,6 +1041,7 @@ void CTypeInfo::SerializeUnrealProps(FArchive &Ar, void *ObjectData) const
 #endif
 
 	int PropTagPos;
+	int PropCursor = -1;		// hint for FindProperty()
 
 #if DEBUG_PROPS
 	appPrintf("-- Property list for %s --\n", Name);
@@ -1065,7 +1221,7 @@ void CTypeInfo::SerializeUnrealProps(FArchive &Ar, void *ObjectData) const
 
 		int StopPos = Ar.Tell() + Tag.DataSize;	// for verification
 
-		const CPropInfo *Prop = FindProperty(Tag.Name);
+		const CPropInfo *Prop = FindProperty(Tag.Name, &PropCursor);
 		if (!Prop || !Prop->TypeName)	// Prop->TypeName==NULL when declared with PROP_DROP() macro
 		{
 			if (!Prop)
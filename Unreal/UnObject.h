@@ -60,7 +60,7 @@ public:
 	static int				GObjBeginLoadCount;
 	static TArray<UObject*>	GObjLoaded;
 	static TArray<UObject*> GObjObjects;
-	static UObject			*GLoadingObj;
+	static THREAD_LOCAL UObject *GLoadingObj;		// object being serialized by the current thread
 
 	static void BeginLoad();
 	static void EndLoad();
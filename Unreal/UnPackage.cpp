@@ -6,9 +6,13 @@
 #include "UnPackageUE3Reader.h"
 
 #include "GameDatabase.h"		// for GetGameTag()
+#include "Parallel.h"			// for UnPackage::LoadPackages() and serialization from worker threads
 
 byte GForceCompMethod = 0;		// COMPRESS_...
 
+// Set while package is created by UnPackage::LoadPackages() worker
+static THREAD_LOCAL bool GLoadingPackageInWorker = false;
+
 
 //#define DEBUG_PACKAGE			1
 //#define PROFILE_PACKAGE_TABLES	1
@@ -528,6 +532,9 @@ static void SerializePackageFileSummary4(FArchive &Ar, FPackageFileSummary &S)
 
 	if (S.IsUnversioned && GForceGame == GAME_UNKNOWN)
 	{
+		// UnPackage::LoadPackages() loads such packages in the calling thread
+		if (GLoadingPackageInWorker)
+			appError("Unversioned package can't be loaded by worker thread");
 		int ver = -S.LegacyVersion - 1;
 		int verMin = legacyVerToEngineVer[ver];
 		int verMax = legacyVerToEngineVer[ver+1] - 1;
@@ -1264,8 +1271,12 @@ FArchive& operator<<(FArchive &Ar, FObjectImport &I)
 	Package loading (creation) / unloading
 -----------------------------------------------------------------------------*/
 
-UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
+UnPackage::UnPackage(const char *filename, const CGameFileInfo* fileInfo, bool silent)
 :	Loader(NULL)
+,	ExportHash(NULL)
+,	ExportHashNext(NULL)
+,	ExportHashSize(0)
+,	FileInfo(fileInfo)
 {
 	guard(UnPackage::UnPackage);
 
@@ -1275,6 +1286,7 @@ UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 
 	IsLoading = true;
 	Filename = appStrdupPool(appSkipRootDir(filename));
+	FArchive* baseLoader = fileInfo ? appCreateFileReader(fileInfo) : NULL;
 	Loader = CreateLoader(filename, baseLoader);
 	SetupFrom(*Loader);
 
@@ -1313,7 +1325,9 @@ UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 	}
 #endif // DEBUG_PACKAGE
 
+	FlushReadWindow();
 	ReplaceLoader();
+	IsLoaderReplaced = (Loader != baseLoader);
 
 #if UNREAL3
 	if (Game >= GAME_UE3 && Summary.CompressionFlags && Summary.CompressedChunks.Num())
@@ -1330,28 +1344,6 @@ UnPackage::UnPackage(const char *filename, FArchive *baseLoader, bool silent)
 	LoadImportTable();
 	LoadExportTable();
 
-#if UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS			// we can serialize dependencies when needed
-	if (Game == GAME_DCUniverse || Game == GAME_Bioshock3) goto no_depends;		// has non-standard checks
-	if (Summary.DependsOffset)						// some games are patrially upgraded: ArVer >= 415, but no depends table
-	{
-		guard(ReadDependsTable);
-		Seek(Summary.DependsOffset);
-		FObjectDepends *Dep = DependsTable = new FObjectDepends[Summary.ExportCount];
-		for (int i = 0; i < Summary.ExportCount; i++, Dep++)
-		{
-			*this << *Dep;
-/*			if (Dep->Objects.Num())
-			{
-				const FObjectExport &Exp = ExportTable[i];
-				appPrintf("Depends for %s'%s' = %d\n", GetObjectName(Exp.ClassIndex),
-					*Exp.ObjectName, Dep->Objects[i]);
-			} */
-		}
-		unguard;
-	}
-no_depends: ;
-#endif // UNREAL3 && !USE_COMPACT_PACKAGE_STRUCTS
-
 #if UNREAL4
 	// Process Event Driven Loader packages: such packages are split into 2 pieces: .uasset with headers
 	// and .uexp with object's data. At this moment we already have FPackageFileSummary fully loaded,
@@ -1372,8 +1364,10 @@ no_depends: ;
 			// Open .exp file
 			FArchive* expLoader = appCreateFileReader(expInfo);
 			// Replace loader with this file, but add offset so it will work like it is part of original uasset
+			FlushReadWindow();
 			delete Loader;
-			Loader = new FReaderWrapper(expLoader, -Summary.HeadersSize);
+			Loader = new FReaderWrapper(expLoader, -Summary.HeadersSize, true);
+			ExpFileInfo = expInfo;
 		}
 		else
 		{
@@ -1382,7 +1376,7 @@ no_depends: ;
 	}
 #endif // UNREAL4
 
-	// add self to package map
+	// compute short package name
 	char buf[MAX_PACKAGE_PATH];
 	const char *s = strrchr(filename, '/');
 	if (!s) s = strrchr(filename, '\\');			// WARNING: not processing mixed '/' and '\'
@@ -1391,7 +1385,6 @@ no_depends: ;
 	char *s2 = strchr(buf, '.');
 	if (s2) *s2 = 0;
 	Name = appStrdupPool(buf);
-	PackageMap.Add(this);
 
 	// Release package file handle
 	CloseReader();
@@ -1404,6 +1397,49 @@ no_depends: ;
 }
 
 
+// Name table size is not stored in package, so it is computed as distance to the nearest table
+// following the name table. Returns 0 when it couldn't be determined.
+int UnPackage::GetNameTableSize() const
+{
+	int End = 0x7FFFFFFF;
+	if (Summary.ImportCount > 0 && Summary.ImportOffset > Summary.NameOffset)
+		End = min(End, Summary.ImportOffset);
+	if (Summary.ExportCount > 0 && Summary.ExportOffset > Summary.NameOffset)
+		End = min(End, Summary.ExportOffset);
+#if UNREAL3
+	if (Game >= GAME_UE3 && Summary.DependsOffset > Summary.NameOffset)
+		End = min(End, Summary.DependsOffset);
+#endif
+	int Size = End - Summary.NameOffset;
+	if (Size <= 0 || Size > (64 << 20)) return 0;	// no table after names, or bad offsets
+	return Size;
+}
+
+// Memory reader for the name table of estimated size, remembers an attempt to read data behind the buffer
+class FNameTableReader : public FMemReader
+{
+	DECLARE_ARCHIVE(FNameTableReader, FMemReader);
+public:
+	bool		Overrun;
+
+	FNameTableReader(const void *data, int size)
+	:	FMemReader(data, size)
+	,	Overrun(false)
+	{}
+
+	virtual void Seek(int Pos)
+	{
+		if (Pos > DataSize) Overrun = true;
+		FMemReader::Seek(Pos);
+	}
+
+	virtual void Serialize(void *data, int size)
+	{
+		if (Tell() + size > DataSize) Overrun = true;
+		FMemReader::Serialize(data, size);
+	}
+};
+
 void UnPackage::LoadNameTable()
 {
 	guard(UnPackage::LoadNameTable);
@@ -1412,6 +1448,45 @@ void UnPackage::LoadNameTable()
 
 	Seek(Summary.NameOffset);
 	NameTable = new const char* [Summary.NameCount];
+
+	int NameTableSize = GetNameTableSize();
+	if (NameTableSize > 0)
+	{
+		// Read the whole table at once and parse it from memory, this is much faster than
+		// reading small pieces through the package loader
+		byte* NameData = (byte*)appMalloc(NameTableSize, 8, true);
+		Serialize(NameData, NameTableSize);
+		FNameTableReader NameReader(NameData, NameTableSize);
+		NameReader.SetupFrom(*this);
+		bool Loaded = false;
+		TRY
+		{
+			LoadNameTable(NameReader);
+			Loaded = true;
+		}
+		CATCH
+		{
+			// error is handled below, after releasing the buffer
+		}
+		appFree(NameData);
+		if (Loaded) return;
+		// Only a wrong table size estimate is handled here, other errors are passed to the caller
+		if (!NameReader.Overrun)
+			appRaiseErrorHistory(GErrorHistory);
+		// Read the table again directly from the package
+		GErrorHistory[0] = 0;
+		GIsSwError = false;
+		Seek(Summary.NameOffset);
+	}
+	LoadNameTable(*this);
+
+	unguard;
+}
+
+void UnPackage::LoadNameTable(FArchive& Ar)
+{
+	guard(UnPackage::LoadNameTable);
+
 	for (int i = 0; i < Summary.NameCount; i++)
 	{
 		guard(Name);
@@ -1422,7 +1497,7 @@ void UnPackage::LoadNameTable()
 			for (len = 0; len < ARRAY_COUNT(buf); len++)
 			{
 				char c;
-				*this << c;
+				Ar << c;
 				buf[len] = c;
 				if (!c) break;
 			}
@@ -1430,7 +1505,7 @@ void UnPackage::LoadNameTable()
 			NameTable[i] = appStrdupPool(buf);
 			// skip object flags
 			int tmp;
-			*this << tmp;
+			Ar << tmp;
 		}
 #if UC1 || PARIAH
 		else if (Game == GAME_UC1 && ArLicenseeVer >= 28)
@@ -1439,13 +1514,13 @@ void UnPackage::LoadNameTable()
 			// used uint16 + char[] instead of FString
 			char buf[MAX_FNAME_LEN];
 			uint16 len;
-			*this << len;
+			Ar << len;
 			assert(len < ARRAY_COUNT(buf));
-			Serialize(buf, len+1);
+			Ar.Serialize(buf, len+1);
 			NameTable[i] = appStrdupPool(buf);
 			// skip object flags
 			int tmp;
-			*this << tmp;
+			Ar << tmp;
 		}
 	#if PARIAH
 		else if (Game == GAME_Pariah && ((ArLicenseeVer & 0x3F) >= 28)) goto uc1_name;
@@ -1461,11 +1536,11 @@ void UnPackage::LoadNameTable()
 				char buf[MAX_FNAME_LEN];
 				byte len;
 				int flags;
-				*this << len;
+				Ar << len;
 				assert(len < ARRAY_COUNT(buf));
-				Serialize(buf, len+1);
+				Ar.Serialize(buf, len+1);
 				NameTable[i] = appStrdupPool(buf);
-				*this << flags;
+				Ar << flags;
 				goto done;
 			}
 #endif // SPLINTER_CELL
@@ -1474,9 +1549,9 @@ void UnPackage::LoadNameTable()
 			{
 				char buf[MAX_FNAME_LEN];
 				int len;
-				*this << AR_INDEX(len);
+				Ar << AR_INDEX(len);
 				assert(len < ARRAY_COUNT(buf));
-				Serialize(buf, len);
+				Ar.Serialize(buf, len);
 				buf[len] = 0;
 				NameTable[i] = appStrdupPool(buf);
 				goto done;
@@ -1488,7 +1563,7 @@ void UnPackage::LoadNameTable()
 				guard(AA2_FName);
 				char buf[MAX_FNAME_LEN];
 				int len;
-				*this << AR_INDEX(len);
+				Ar << AR_INDEX(len);
 				// read as unicode string and decrypt
 				assert(len <= 0);
 				len = -len;
@@ -1498,7 +1573,7 @@ void UnPackage::LoadNameTable()
 				for (int j = 0; j < len; j++, d++)
 				{
 					uint16 c;
-					*this << c;
+					Ar << c;
 					uint16 c2 = ROR16(c, shift);
 					assert(c2 < 256);
 					*d = c2 & 0xFF;
@@ -1506,7 +1581,7 @@ void UnPackage::LoadNameTable()
 				}
 				NameTable[i] = appStrdupPool(buf);
 				int unk;
-				*this << AR_INDEX(unk);
+				Ar << AR_INDEX(unk);
 				unguard;
 				goto dword_flags;
 			}
@@ -1516,10 +1591,10 @@ void UnPackage::LoadNameTable()
 			{
 				char buf[MAX_FNAME_LEN];
 				int len;
-				*this << len;
+				Ar << len;
 				assert(len > 0 && len < 0x3FF);	// requires extra code
 				assert(len < ARRAY_COUNT(buf));
-				Serialize(buf, len);
+				Ar.Serialize(buf, len);
 				buf[len] = 0;
 				NameTable[i] = appStrdupPool(buf);
 				goto qword_flags;
@@ -1530,9 +1605,9 @@ void UnPackage::LoadNameTable()
 			{
 				char buf[MAX_FNAME_LEN];
 				byte len;
-				*this << len;
+				Ar << len;
 				assert(len < ARRAY_COUNT(buf));
-				Serialize(buf, len);
+				Ar.Serialize(buf, len);
 				buf[len] = 0;
 				NameTable[i] = appStrdupPool(buf);
 				goto done;
@@ -1543,9 +1618,9 @@ void UnPackage::LoadNameTable()
 			{
 				char buf[MAX_FNAME_LEN];
 				int len;
-				*this << len;
+				Ar << len;
 				assert(len < ARRAY_COUNT(buf));
-				Serialize(buf, len);
+				Ar.Serialize(buf, len);
 				buf[len] = 0;
 				NameTable[i] = appStrdupPool(buf);
 				goto qword_flags;
@@ -1553,7 +1628,7 @@ void UnPackage::LoadNameTable()
 #endif // TRANSFORMERS
 
 			// Korean games sometimes uses Unicode strings ...
-			*this << name;
+			Ar << name;
 	#if AVA
 			if (Game == GAME_AVA)
 			{
@@ -1563,7 +1638,7 @@ void UnPackage::LoadNameTable()
 				// Number of bytes = (len ^ 7) & 0xF
 				int skip = name.Len();
 				skip = (skip ^ 7) & 0xF;
-				Seek(Tell() + skip);
+				Ar.Seek(Ar.Tell() + skip);
 			}
 	#endif // AVA
 
@@ -1617,7 +1692,7 @@ void UnPackage::LoadNameTable()
 				{
 				name_hashes:
 					int16 NonCasePreservingHash, CasePreservingHash;
-					*this << NonCasePreservingHash << CasePreservingHash;
+					Ar << NonCasePreservingHash << CasePreservingHash;
 				}
 				// skip object flags
 				goto done;
@@ -1655,7 +1730,7 @@ void UnPackage::LoadNameTable()
 				{
 					TrashLen = name.Len() ^ 6;
 				}
-				this->Seek(this->Tell() + (TrashLen & 0xF));
+				Ar.Seek(Ar.Tell() + (TrashLen & 0xF));
 			}
 		#endif // METRO_CONF
 			if (Game >= GAME_UE3 && ArVer >= 195)
@@ -1663,14 +1738,14 @@ void UnPackage::LoadNameTable()
 			qword_flags:
 				// object flags are 64-bit in UE3, skip additional 32 bits
 				int64 flags64;
-				*this << flags64;
+				Ar << flags64;
 				goto done;
 			}
 	#endif // UNREAL3
 
 		dword_flags:
 			int flags32;
-			*this << flags32;
+			Ar << flags32;
 		}
 	done: ;
 #if DEBUG_PACKAGE
@@ -1741,18 +1816,69 @@ void UnPackage::LoadExportTable()
 }
 
 
+#if UNREAL3
+
+void UnPackage::LoadDependsTable()
+{
+	guard(UnPackage::LoadDependsTable);
+
+	DependsTableLoaded = true;
+
+	if (Game < GAME_UE3 || Summary.ExportCount == 0) return;
+#if UNREAL4
+	if (Game >= GAME_UE4_BASE) return;				// UE4 has different dependency data, and header could be in a separate file
+#endif
+	if (Game == GAME_DCUniverse || Game == GAME_Bioshock3) return;	// has non-standard checks
+	if (!Summary.DependsOffset) return;				// some games are patrially upgraded: ArVer >= 415, but no depends table
+
+	// The package could be in use by object loader, so preserve current position
+	bool WasOpen = Loader->IsOpen();
+	if (!WasOpen) Loader->Open();
+	int SavedPos = Tell();
+	int SavedStopper = GetStopper();
+	SetStopper(0);
+
+	Seek(Summary.DependsOffset);
+	FObjectDepends *Dep = DependsTable = new FObjectDepends[Summary.ExportCount];
+	for (int i = 0; i < Summary.ExportCount; i++, Dep++)
+		*this << *Dep;
+
+	SetStopper(SavedStopper);
+	if (WasOpen)
+		Seek(SavedPos);
+	else
+		CloseReader();
+
+	unguard;
+}
+
+const FObjectDepends* UnPackage::GetDepends(int ExportIndex)
+{
+	GetExport(ExportIndex);							// validate index
+	if (!DependsTableLoaded)
+		LoadDependsTable();
+	return DependsTable ? &DependsTable[ExportIndex] : NULL;
+}
+
+#endif // UNREAL3
+
+
 UnPackage::~UnPackage()
 {
 	guard(UnPackage::~UnPackage);
 
 	// free tables
+	if (ThreadLoaderPackage == this) SetThreadLoader(NULL);
 	if (Loader) delete Loader;
+	for (int i = 0; i < ExportReaders.Num(); i++)
+		delete ExportReaders[i];
 	delete NameTable;
 	delete ImportTable;
 	delete ExportTable;
 #if UNREAL3
-	if (DependsTable) delete DependsTable;
+	if (DependsTable) delete[] DependsTable;
 #endif
+	if (ExportHash) appFree(ExportHash);
 	// remove self from package table
 	int i = PackageMap.FindItem(this);
 	assert(i != INDEX_NONE);
@@ -1794,6 +1920,156 @@ static FFileArchive* FindFileArchive(FArchive* Ar)
 }
 #endif
 
+int GExportPrefetchSize = 4 << 20;
+
+// Export data read into memory by UnPackage::SetupReader(). Uses package positions, so Tell() and
+// stopper works as for the package reader. Data outside of the export (e.g. bulk data stored at the
+// end of the package) is read from the package reader.
+class FExportPrefetchReader : public FArchive
+{
+	DECLARE_ARCHIVE(FExportPrefetchReader, FArchive);
+public:
+	FArchive*		Reader;				// package reader
+	TArray<byte>	Buffer;				// reused for all exports loaded by the thread
+	int				DataPos;			// package position of the buffer
+	int				DataSize;
+
+	FExportPrefetchReader()
+	:	Reader(NULL)
+	,	DataPos(0)
+	,	DataSize(0)
+	{
+		IsLoading = true;
+	}
+
+	void Prefetch(FArchive* InReader, int Pos, int Size)
+	{
+		guard(FExportPrefetchReader::Prefetch);
+		DropReadWindow();
+		Reader = InReader;
+		DataPos = Pos;
+		DataSize = 0;					// keep the reader consistent if Serialize() fails
+		if (Buffer.Num() < Size)
+		{
+			Buffer.Empty();
+			Buffer.AddUninitialized(Size);
+		}
+		Reader->SetStopper(Pos + Size);
+		Reader->Seek(Pos);
+		Reader->Serialize(Buffer.GetData(), Size);
+		DataSize = Size;
+		ArPos = Pos;
+		ArStopper = Pos + Size;
+		SetupReadWindow();
+		unguard;
+	}
+
+	// Whole export is available for inline serializers, until Seek() or SetStopper() call
+	void SetupReadWindow()
+	{
+		int WindowEnd = DataPos + DataSize;
+		if (ArStopper > 0 && ArStopper < WindowEnd) WindowEnd = ArStopper;
+		if (ArPos < DataPos || ArPos >= WindowEnd) return;
+		ReadPtr = Buffer.GetData() + (ArPos - DataPos);
+		ReadEnd = Buffer.GetData() + (WindowEnd - DataPos);
+		ArPos = WindowEnd;
+	}
+
+	virtual void Seek(int Pos)
+	{
+		DropReadWindow();
+		ArPos = Pos;
+	}
+
+	virtual int Tell() const
+	{
+		return ArPos - (int)(ReadEnd - ReadPtr);
+	}
+
+	virtual void Serialize(void *data, int size)
+	{
+		guard(FExportPrefetchReader::Serialize);
+		ArPos -= DropReadWindow();
+		if (ArStopper > 0 && ArPos + size > ArStopper)
+			appError("Serializing behind stopper (%X+%X > %X)", ArPos, size, ArStopper);
+		int Offset = ArPos - DataPos;
+		if (Offset >= 0 && Offset + size <= DataSize)
+		{
+			memcpy(data, Buffer.GetData() + Offset, size);
+		}
+		else
+		{
+			Reader->Seek(ArPos);
+			Reader->Serialize(data, size);
+		}
+		ArPos += size;
+		SetupReadWindow();
+		unguard;
+	}
+
+	virtual void ReadAt(int64 Pos, void *data, int size)
+	{
+		int64 Offset = Pos - DataPos;
+		if (Offset >= 0 && Offset + size <= DataSize)
+			memcpy(data, Buffer.GetData() + Offset, size);
+		else
+			Reader->ReadAt(Pos, data, size);
+	}
+
+	// Buffer is reused by the next export, so give out data of the package reader only
+	virtual const byte* BorrowData(int64 Pos, int size)
+	{
+		return Reader->BorrowData(Pos, size);
+	}
+
+	virtual void SetStopper(int Pos)
+	{
+		ArPos -= DropReadWindow();
+		ArStopper = Pos;
+		Reader->SetStopper(Pos);
+	}
+
+	virtual bool IsCompressed() const
+	{
+		return Reader->IsCompressed();
+	}
+	virtual int GetFileSize() const
+	{
+		return Reader->GetFileSize();
+	}
+	virtual bool IsOpen() const
+	{
+		return Reader->IsOpen();
+	}
+	virtual bool Open()
+	{
+		return Reader->Open();
+	}
+	virtual void Close()
+	{
+		Reader->Close();
+	}
+};
+
+static THREAD_LOCAL FExportPrefetchReader* GPrefetchReader = NULL;
+
+void UnPackage::UpdateReadWindow()
+{
+	FArchive* Reader = GetLoader();
+	if (Reader->ReadPtr && GetBaseLoader() == Loader)
+	{
+		ReadPtr = Reader->ReadPtr;
+		ReadEnd = Reader->ReadEnd;
+	}
+}
+
+FArchive* UnPackage::GetBaseLoader() const
+{
+	FArchive* Reader = GetLoader();
+	if (Reader == GPrefetchReader) Reader = GPrefetchReader->Reader;
+	return Reader;
+}
+
 void UnPackage::SetupReader(int ExportIndex)
 {
 	guard(UnPackage::SetupReader);
@@ -1803,17 +2079,47 @@ void UnPackage::SetupReader(int ExportIndex)
 	assert(File);
 	if (!File->IsOpen()) File->Open();
 #else
-	if (!Loader->IsOpen()) Loader->Open();
+	FlushReadWindow();
+	// previous object could fail to load without ReleaseReader() call
+	FArchive* Reader = GetBaseLoader();
+	if (!Reader->IsOpen()) Reader->Open();
 #endif
 	// setup for object
 	const FObjectExport &Exp = GetExport(ExportIndex);
-	SetStopper(Exp.SerialOffset + Exp.SerialSize);
-	Seek(Exp.SerialOffset);
+	if (Exp.SerialSize > 0 && Exp.SerialSize <= GExportPrefetchSize &&
+		Exp.SerialOffset + Exp.SerialSize <= Reader->GetFileSize())
+	{
+		// read whole export with a single call
+		if (!GPrefetchReader) GPrefetchReader = new FExportPrefetchReader;	// one per thread, never released
+		GPrefetchReader->Prefetch(Reader, Exp.SerialOffset, Exp.SerialSize);
+		ThreadLoaderPackage = this;
+		ThreadLoader = GPrefetchReader;
+		UpdateReadWindow();
+		return;
+	}
+	if (Reader != GetLoader())
+		SetThreadLoader(Reader != Loader ? Reader : NULL);
+	Reader->SetStopper(Exp.SerialOffset + Exp.SerialSize);
+	Reader->Seek(Exp.SerialOffset);
 	unguard;
 }
 
+void UnPackage::ReleaseReader()
+{
+	FlushReadWindow();
+	FArchive* Reader = GetLoader();
+	if (Reader != GPrefetchReader) return;
+	// switch back to package reader, keeping position and stopper
+	FArchive* BaseReader = GPrefetchReader->Reader;
+	int Pos = Reader->Tell();
+	if (BaseReader->Tell() != Pos)
+		BaseReader->Seek(Pos);				// some readers can't seek to the end of file
+	SetThreadLoader(BaseReader != Loader ? BaseReader : NULL);
+}
+
 void UnPackage::CloseReader()
 {
+	FlushReadWindow();
 #if 0
 	FFileArchive* File = FindFileArchive(Loader);
 	assert(File);
@@ -1821,6 +2127,9 @@ void UnPackage::CloseReader()
 #else
 	Loader->Close();
 #endif
+	for (int i = 0; i < ExportReaders.Num(); i++)
+		delete ExportReaders[i];
+	ExportReaders.Empty();
 }
 
 void UnPackage::CloseAllReaders()
@@ -1832,6 +2141,73 @@ void UnPackage::CloseAllReaders()
 	}
 }
 
+THREAD_LOCAL const UnPackage* UnPackage::ThreadLoaderPackage = NULL;
+THREAD_LOCAL FArchive* UnPackage::ThreadLoader = NULL;
+
+FArchive* UnPackage::CreateExportReader() const
+{
+	guard(UnPackage::CreateExportReader);
+
+	if (!CanCreateExportReader()) return NULL;
+
+	// Repeat the Loader setup from the constructor
+	FArchive* Reader;
+#if UNREAL4
+	if (ExpFileInfo)
+	{
+		Reader = new FReaderWrapper(appCreateFileReader(ExpFileInfo), -Summary.HeadersSize, true);
+	}
+	else
+#endif
+	{
+		Reader = appCreateFileReader(FileInfo);
+#if UNREAL3
+		if (Game >= GAME_UE3 && Summary.CompressionFlags && Summary.CompressedChunks.Num())
+			Reader = new FUE3ArchiveReader(Reader, Summary.CompressionFlags, Summary.CompressedChunks);
+#endif
+	}
+	Reader->SetupFrom(*this);
+	return Reader;
+
+	unguardf("%s", Filename);
+}
+
+static CSpinLock ExportReadersLock;
+
+FArchive* UnPackage::AcquireExportReader()
+{
+	{
+		TScopeLock<CSpinLock> Lock(ExportReadersLock);
+		int Count = ExportReaders.Num();
+		if (Count)
+		{
+			FArchive* Reader = ExportReaders[Count - 1];
+			ExportReaders.RemoveAt(Count - 1);
+			return Reader;
+		}
+	}
+	return CreateExportReader();
+}
+
+void UnPackage::ReleaseExportReader(FArchive* Reader)
+{
+	TScopeLock<CSpinLock> Lock(ExportReadersLock);
+	ExportReaders.Add(Reader);
+}
+
+void UnPackage::LoadImportPackages()
+{
+	guard(UnPackage::LoadImportPackages);
+	for (int i = 0; i < Summary.ImportCount; i++)
+	{
+		// outermost import is a package, the same name is used by CreateImport()
+		const FObjectImport &Imp = ImportTable[i];
+		if (Imp.PackageIndex == 0)
+			LoadPackage(Imp.ObjectName);
+	}
+	unguardf("%s", Filename);
+}
+
 
 /*-----------------------------------------------------------------------------
 	UObject* and FName serializers
@@ -1936,21 +2312,22 @@ FArchive& UnPackage::operator<<(UObject *&Obj)
 #endif // UNREAL3 || UNREAL4
 		*this << AR_INDEX(index);
 
-	if (index < 0)
+	if (index == 0)
 	{
-//		const FObjectImport &Imp = GetImport(-index-1);
-//		appPrintf("PKG: Import[%s,%d] OBJ=%s CLS=%s\n", GetObjectName(Imp.PackageIndex), index, *Imp.ObjectName, *Imp.ClassName);
-		Obj = CreateImport(-index-1);
+		Obj = NULL;
 	}
-	else if (index > 0)
+	else if (ThreadLoaderPackage == this && GetBaseLoader() != Loader)
 	{
-//		const FObjectExport &Exp = GetExport(index-1);
-//		appPrintf("PKG: Export[%d] OBJ=%s CLS=%s\n", index, *Exp.ObjectName, GetObjectName(Exp.ClassIndex));
-		Obj = CreateExport(index-1);
+		// Objects are serialized by several threads (see UObject::EndLoad()), and object creation
+		// modifies shared data. Imported packages are already loaded by the calling thread, see
+		// LoadImportPackages().
+		static CMutex CreateObjectLock;
+		TScopeLock<CMutex> Lock(CreateObjectLock);
+		Obj = (index < 0) ? CreateImport(-index-1) : CreateExport(index-1);
 	}
-	else // index == 0
+	else
 	{
-		Obj = NULL;
+		Obj = (index < 0) ? CreateImport(-index-1) : CreateExport(index-1);
 	}
 	return *this;
 
@@ -1961,10 +2338,39 @@ FArchive& UnPackage::operator<<(UObject *&Obj)
 	Loading particular import or export package entry
 -----------------------------------------------------------------------------*/
 
+void UnPackage::BuildExportHash() const
+{
+	guard(UnPackage::BuildExportHash);
+
+	int Count = Summary.ExportCount;
+	int Size = 16;
+	while (Size < Count)
+		Size *= 2;
+	ExportHash = (int*)appMalloc((Size + Count) * sizeof(int), 8, true);
+	ExportHashNext = ExportHash + Size;
+	ExportHashSize = Size;
+	for (int i = 0; i < Size; i++)
+		ExportHash[i] = INDEX_NONE;
+	// iterate in reverse order, so chains will have increasing indices
+	for (int i = Count - 1; i >= 0; i--)
+	{
+		// export names are pooled, so the case-insensitive hash is already computed
+		int bucket = appGetPoolStringHash(ExportTable[i].ObjectName.Str) & (Size - 1);
+		ExportHashNext[i] = ExportHash[bucket];
+		ExportHash[bucket] = i;
+	}
+
+	unguardf("%s", Filename);
+}
+
 int UnPackage::FindExport(const char *name, const char *className, int firstIndex) const
 {
-	for (int i = firstIndex; i < Summary.ExportCount; i++)
+	if (!ExportHash) BuildExportHash();
+
+	int bucket = appStrihash(name) & (ExportHashSize - 1);
+	for (int i = ExportHash[bucket]; i != INDEX_NONE; i = ExportHashNext[i])
 	{
+		if (i < firstIndex) continue;
 		const FObjectExport &Exp = ExportTable[i];
 		// compare object name
 		if (stricmp(Exp.ObjectName, name) != 0)
@@ -2370,7 +2776,8 @@ TArray<char*>		MissingPackages;
 		if (info->Package)
 			return info->Package;
 		// Load the package.
-		UnPackage* package = new UnPackage(info->RelativeName, appCreateFileReader(info), silent);
+		UnPackage* package = new UnPackage(info->RelativeName, info, silent);
+		PackageMap.Add(package);
 		// Cache pointer in CGameFileInfo so next time it will be found quickly.
 		const_cast<CGameFileInfo*>(info)->Package = package;
 		return package;
@@ -2395,7 +2802,11 @@ TArray<char*>		MissingPackages;
 				return PackageMap[i];
 		// Try to load package.
 		if (appFileExists(Name))
-			return new UnPackage(Name, NULL, silent);
+		{
+			UnPackage* package = new UnPackage(Name, NULL, silent);
+			PackageMap.Add(package);
+			return package;
+		}
 	}
 
 	// The package is missing. Do not print any warnings: missing package is a normal situation
@@ -2406,3 +2817,95 @@ TArray<char*>		MissingPackages;
 
 	unguardf("%s", Name);
 }
+
+#if UNREAL4
+
+// Check whether the file is an unversioned UE4 package by reading the beginning of the file. Loading
+// such package when GForceGame is not set yet changes global state and may ask user.
+static bool IsUnversionedUE4Package(const CGameFileInfo* info)
+{
+	guard(IsUnversionedUE4Package);
+
+	// Tag, LegacyVersion, [VersionUE3], Version, LicenseeVersion
+	int32 Data[5];
+	FArchive* Ar = appCreateFileReader(info);
+	bool Result = false;
+	if (Ar->GetFileSize() >= (int)sizeof(Data))
+	{
+		Ar->Serialize(Data, sizeof(Data));
+		if ((uint32)Data[0] == PACKAGE_FILE_TAG && Data[1] < -1)
+		{
+			int VersionIndex = (Data[1] == -4) ? 2 : 3;
+			Result = (Data[VersionIndex] == 0 && Data[VersionIndex + 1] == 0);
+		}
+	}
+	delete Ar;
+	return Result;
+
+	unguardf("%s", info->RelativeName);
+}
+
+#endif // UNREAL4
+
+/*static*/ void UnPackage::LoadPackages(const TArray<const CGameFileInfo*>& Files, TArray<UnPackage*>& OutPackages)
+{
+	guard(UnPackage::LoadPackages);
+
+	OutPackages.Empty(Files.Num());
+	OutPackages.AddZeroed(Files.Num());
+	for (int i = 0; i < Files.Num(); i++)
+		OutPackages[i] = Files[i]->Package;
+
+	// Package constructor doesn't modify any shared data, so packages could be created in parallel.
+	// Registration is done later in this thread. Unversioned UE4 packages are skipped by worker threads
+	// until the engine version is selected, and loaded here.
+	TArray<bool> Deferred;
+	Deferred.AddZeroed(Files.Num());
+	char ErrorHistory[ARRAY_COUNT(GErrorHistory)];
+	ErrorHistory[0] = 0;
+	TRY
+	{
+		ParallelFor(Files.Num(), [&](int i)
+			{
+				const CGameFileInfo* info = Files[i];
+				if (OutPackages[i] || !info->IsPackage) return;
+#if UNREAL4
+				if (GForceGame == GAME_UNKNOWN && IsUnversionedUE4Package(info))
+				{
+					Deferred[i] = true;
+					return;
+				}
+#endif
+				GLoadingPackageInWorker = true;
+				OutPackages[i] = new UnPackage(info->RelativeName, info, /*silent=*/ true);
+				GLoadingPackageInWorker = false;
+			});
+		for (int i = 0; i < Files.Num(); i++)
+		{
+			if (Deferred[i])
+				OutPackages[i] = new UnPackage(Files[i]->RelativeName, Files[i], /*silent=*/ true);
+		}
+	}
+	CATCH
+	{
+		GLoadingPackageInWorker = false;	// when error was raised in this thread
+		appStrncpyz(ErrorHistory, GErrorHistory, ARRAY_COUNT(ErrorHistory));
+		GErrorHistory[0] = 0;
+	}
+
+	// Register packages in the order of Files array, including ones loaded before an error
+	for (int i = 0; i < Files.Num(); i++)
+	{
+		UnPackage* package = OutPackages[i];
+		if (package && !Files[i]->Package)
+		{
+			PackageMap.Add(package);
+			const_cast<CGameFileInfo*>(Files[i])->Package = package;
+		}
+	}
+
+	if (ErrorHistory[0])
+		appRaiseErrorHistory(ErrorHistory);
+
+	unguard;
+}
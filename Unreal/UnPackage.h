@@ -217,6 +217,10 @@ struct FObjectDepends
 #endif // UNREAL3
 
 
+// Exports not larger than this value are read into memory with a single read before object
+// serialization (see UnPackage::SetupReader()). Set to 0 to disable.
+extern int GExportPrefetchSize;
+
 // In Unreal Engine class with similar functionality named "ULinkerLoad"
 class UnPackage : public FArchive
 {
@@ -232,11 +236,11 @@ public:
 	FObjectImport			*ImportTable;
 	FObjectExport			*ExportTable;
 #if UNREAL3
-	FObjectDepends			*DependsTable;
+	FObjectDepends			*DependsTable;		// loaded on demand, use GetDepends()
 #endif
 
 protected:
-	UnPackage(const char *filename, FArchive *baseLoader = NULL, bool silent = false);
+	UnPackage(const char *filename, const CGameFileInfo* fileInfo = NULL, bool silent = false);
 	~UnPackage();
 
 public:
@@ -244,6 +248,10 @@ public:
 	// When the package is already loaded, this function will simply return a pointer
 	// to previously loaded UnPackage.
 	static UnPackage *LoadPackage(const char *Name, bool silent = false);
+	// Silently load packages for the list of game files using all worker threads. Packages are registered
+	// in the order of Files, so the result is the same as for sequential LoadPackage() calls. OutPackages
+	// receives NULL for files which are not packages.
+	static void LoadPackages(const TArray<const CGameFileInfo*>& Files, TArray<UnPackage*>& OutPackages);
 	// We've protected UnPackage's destructor, however it is possible to use UnloadPackage to destroy package.
 	static void UnloadPackage(UnPackage* package);
 
@@ -258,13 +266,45 @@ public:
 	}
 
 	// Prepare for serialization of particular object. Will open a reader if it was
-	// closed before.
+	// closed before. Small exports are prefetched into memory, and object data is
+	// served from memory until ReleaseReader() is called.
 	void SetupReader(int ExportIndex);
+	void ReleaseReader();
 	// Close reader when not needed anymore. Could be reopened again with SetupReader().
 	void CloseReader();
 
 	static void CloseAllReaders();
 
+	// Create an additional reader for export data, so objects of this package could be serialized by
+	// several threads at once. Returns NULL when package's Loader can't be duplicated.
+	FArchive* CreateExportReader() const;
+	// Same as CreateExportReader(), but reuses readers returned with ReleaseExportReader(), so
+	// there's one reader per thread working with the package. Readers are deleted in CloseReader().
+	FArchive* AcquireExportReader();
+	void ReleaseExportReader(FArchive* Reader);
+	// Load all packages referenced by the import table. Used before serializing objects from worker
+	// threads, so package loading order doesn't depend on timing.
+	void LoadImportPackages();
+	bool CanCreateExportReader() const
+	{
+		return FileInfo && !IsLoaderReplaced;
+	}
+	// Make serialization of this package in the current thread to use Reader instead of Loader.
+	// Call with NULL to restore Loader.
+	void SetThreadLoader(FArchive* Reader)
+	{
+		// the read window is stored in the package object, which could be used by other threads with
+		// their own readers, so it should be already flushed here
+		assert(!Reader || !ReadPtr);
+		FlushReadWindow();
+		ThreadLoaderPackage = Reader ? this : NULL;
+		ThreadLoader = Reader;
+	}
+	FORCEINLINE FArchive* GetLoader() const
+	{
+		return (ThreadLoaderPackage == this) ? ThreadLoader : Loader;
+	}
+
 	const char* GetName(int index)
 	{
 		if (index < 0 || index >= Summary.NameCount)
@@ -301,6 +341,12 @@ public:
 		return ExportTable[index];
 	}
 
+#if UNREAL3
+	// Get dependencies of the export. The depends table is not needed for listing or loading objects,
+	// so it is read from the package on the first call. Returns NULL if package has no depends table.
+	const FObjectDepends* GetDepends(int ExportIndex);
+#endif
+
 	const char* GetObjectName(int PackageIndex) const	//?? GetExportClassName()
 	{
 		guard(UnPackage::GetObjectName);
@@ -321,6 +367,8 @@ public:
 		unguardf("Index=%d", PackageIndex);
 	}
 
+	// Find export by name (case-insensitive), starting from 'firstIndex'. Uses hash table, so repeated
+	// lookups in large packages are fast.
 	int FindExport(const char *name, const char *className = NULL, int firstIndex = 0) const;
 	int FindExportForImport(const char *ObjectName, const char *ClassName, UnPackage *ImporterPackage, int ImporterIndex);
 	bool CompareObjectPaths(int PackageIndex, UnPackage *RefPackage, int RefPackageIndex) const;
@@ -339,7 +387,7 @@ public:
 
 	virtual bool IsCompressed() const
 	{
-		return Loader->IsCompressed();
+		return GetLoader()->IsCompressed();
 	}
 #if UNREAL4
 	virtual bool ContainsEditorData() const
@@ -352,45 +400,97 @@ public:
 #endif // UNREAL4
 	virtual void Serialize(void *data, int size)
 	{
-		Loader->Serialize(data, size);
+		FlushReadWindow();
+		GetLoader()->Serialize(data, size);
+		UpdateReadWindow();
+	}
+	virtual const byte* BorrowData(int64 Pos, int size)
+	{
+		return GetLoader()->BorrowData(Pos, size);
 	}
 	virtual void Seek(int Pos)
 	{
-		Loader->Seek(Pos);
+		FlushReadWindow();
+		GetLoader()->Seek(Pos);
 	}
 	virtual int Tell() const
 	{
-		return Loader->Tell();
+		const FArchive* Reader = GetLoader();
+		int Pos = Reader->Tell();
+		if (ReadPtr) Pos += (int)(ReadPtr - Reader->ReadPtr);	// bytes consumed from the mirrored window
+		return Pos;
 	}
 	virtual void SetStopper(int Pos)
 	{
-		Loader->SetStopper(Pos);
+		FlushReadWindow();
+		GetLoader()->SetStopper(Pos);
 	}
 	virtual int  GetStopper() const
 	{
-		return Loader->GetStopper();
+		return GetLoader()->GetStopper();
 	}
 	virtual int GetFileSize() const
 	{
-		return Loader->GetFileSize();
+		return GetLoader()->GetFileSize();
 	}
 	virtual bool IsOpen() const
 	{
-		return Loader->IsOpen();
+		return GetLoader()->IsOpen();
 	}
 	virtual bool Open()
 	{
-		return Loader->Open();
+		return GetLoader()->Open();
 	}
 	virtual void Close()
 	{
-		Loader->Close();
+		FlushReadWindow();
+		GetLoader()->Close();
 	}
 
 private:
+	// Package uses the read window of its loader, so inline serializers don't need a virtual call
+	// for every value. Bytes consumed from the window are passed back to the loader before any other
+	// loader call. The window is not used with worker thread readers, because the package object is
+	// shared between threads.
+	void UpdateReadWindow();
+	FORCEINLINE void FlushReadWindow()
+	{
+		if (!ReadPtr) return;
+		FArchive* Reader = GetLoader();
+		if (Reader->ReadEnd == ReadEnd) Reader->ReadPtr = ReadPtr;
+		ReadPtr = ReadEnd = NULL;
+	}
+
 	void LoadNameTable();
+	void LoadNameTable(FArchive& Ar);
+	int GetNameTableSize() const;
 	void LoadImportTable();
 	void LoadExportTable();
+#if UNREAL3
+	void LoadDependsTable();
+	bool					DependsTableLoaded;
+#endif
+
+	// Export name hash, built on the first FindExport() call. ExportHashNext links exports with the
+	// same hash in increasing index order. Both arrays are in a single allocation.
+	mutable int*			ExportHash;			// ExportHashSize items, first export index or INDEX_NONE
+	mutable int*			ExportHashNext;		// Summary.ExportCount items
+	mutable int				ExportHashSize;
+	void BuildExportHash() const;
+
+	// Information for CreateExportReader()
+	const CGameFileInfo*	FileInfo;			// NULL when package was loaded from outside of the game directory
+#if UNREAL4
+	const CGameFileInfo*	ExpFileInfo;		// .uexp file with export data
+#endif
+	bool					IsLoaderReplaced;	// Loader was changed by game-specific code
+	TArray<FArchive*>		ExportReaders;		// free readers for AcquireExportReader()
+
+	// Reader set with SetThreadLoader() or SetupReader()
+	static THREAD_LOCAL const UnPackage* ThreadLoaderPackage;
+	static THREAD_LOCAL FArchive* ThreadLoader;
+	// Reader used by the current thread, ignoring export prefetch
+	FArchive* GetBaseLoader() const;
 
 	static TArray<UnPackage*> PackageMap;
 };
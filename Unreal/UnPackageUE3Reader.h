@@ -27,6 +27,8 @@ public:
 	int						BufferSize;
 	int						BufferStart;
 	int						BufferEnd;
+	// buffer for compressed data, reused between blocks
+	FScratchBuffer			CompressedBuffer;
 	// chunk
 	const FCompressedChunk	*CurrentChunk;
 	FCompressedChunkHeader	ChunkHeader;
@@ -68,6 +70,7 @@ public:
 	{
 		guard(FUE3ArchiveReader::Serialize);
 
+		Position -= DropReadWindow();
 		if (Stopper > 0 && Position + size > Stopper)
 			appError("Serializing behind stopper (%X+%X > %X)", Position, size, Stopper);
 
@@ -83,17 +86,37 @@ public:
 				Position += ToCopy;
 				size     -= ToCopy;
 				data     = OffsetPointer(data, ToCopy);
-				if (!size) return;										// copied enough
+				if (!size) break;										// copied enough
 			}
 			// here: data/size points outside of loaded Buffer
-			PrepareBuffer(Position);
+			int DirectSize = PrepareBuffer(Position, (byte*)data, size);
+			if (DirectSize)
+			{
+				// whole block was decompressed to destination
+				Position += DirectSize;
+				size     -= DirectSize;
+				data     = OffsetPointer(data, DirectSize);
+				if (!size) break;
+				continue;
+			}
 			assert(Position >= BufferStart && Position < BufferEnd);	// validate PrepareBuffer()
 		}
 
+		// expose the rest of decompressed block to inline serializers
+		int WindowEnd = (Stopper > 0 && Stopper < BufferEnd) ? Stopper : BufferEnd;
+		if (Position >= BufferStart && Position < WindowEnd)
+		{
+			ReadPtr = Buffer + Position - BufferStart;
+			ReadEnd = Buffer + WindowEnd - BufferStart;
+			Position = WindowEnd;
+		}
+
 		unguard;
 	}
 
-	void PrepareBuffer(int Pos)
+	// Decompress the block containing Pos into Buffer. When the block starts at Pos and fits into DestSize,
+	// it is decompressed directly to Dest, Buffer is not changed, and the function returns the size of block.
+	int PrepareBuffer(int Pos, byte* Dest = NULL, int DestSize = 0)
 	{
 		guard(FUE3ArchiveReader::PrepareBuffer);
 		// find compressed chunk
@@ -117,7 +140,7 @@ public:
 			BufferEnd   = Size;
 			Reader->Seek(0);
 			Reader->Serialize(Buffer, Size);
-			return;
+			return 0;
 		}
 
 		if (Chunk != CurrentChunk)
@@ -172,44 +195,61 @@ public:
 		}
 		assert(Block);
 		// read compressed data
-		//?? optimize? can share compressed buffer and decompressed buffer between packages
-		byte *CompressedBlock = new byte[Block->CompressedSize];
-		Reader->Seek(ChunkData);
-		Reader->Serialize(CompressedBlock, Block->CompressedSize);
+		const byte *BorrowedBlock = NULL;
+		if (!appDecompressModifiesInput(CompressionFlags))
+			BorrowedBlock = Reader->BorrowData(ChunkData, Block->CompressedSize);
+		if (!BorrowedBlock)
+		{
+			byte* CompressedData = CompressedBuffer.Get(Block->CompressedSize);
+			Reader->Seek(ChunkData);
+			Reader->Serialize(CompressedData, Block->CompressedSize);
+			BorrowedBlock = CompressedData;
+		}
 		// prepare buffer for decompression
-		if (Block->UncompressedSize > BufferSize)
+		byte* DecompressTo;
+		if (ChunkPosition == Pos && Block->UncompressedSize <= DestSize)
 		{
-			if (Buffer) delete[] Buffer;
-			Buffer = new byte[Block->UncompressedSize];
-			BufferSize = Block->UncompressedSize;
+			DecompressTo = Dest;
+		}
+		else
+		{
+			if (Block->UncompressedSize > BufferSize)
+			{
+				if (Buffer) delete[] Buffer;
+				Buffer = new byte[Block->UncompressedSize];
+				BufferSize = Block->UncompressedSize;
+			}
+			DecompressTo = Buffer;
 		}
 		// decompress data
 		guard(DecompressBlock);
 		if (ChunkHeader.BlockSize != -1)	// my own mark
-			appDecompress(CompressedBlock, Block->CompressedSize, Buffer, Block->UncompressedSize, CompressionFlags);
+			appDecompress(const_cast<byte*>(BorrowedBlock), Block->CompressedSize, DecompressTo, Block->UncompressedSize, CompressionFlags);
 		else
 		{
 			// no compression
 			assert(Block->CompressedSize == Block->UncompressedSize);
-			memcpy(Buffer, CompressedBlock, Block->CompressedSize);
+			memcpy(DecompressTo, BorrowedBlock, Block->CompressedSize);
 		}
 		unguardf("block=%X+%X", ChunkData, Block->CompressedSize);
+		if (DecompressTo == Dest)
+			return Block->UncompressedSize;
 		// setup BufferStart/BufferEnd
 		BufferStart = ChunkPosition;
 		BufferEnd   = ChunkPosition + Block->UncompressedSize;
-		// cleanup
-		delete[] CompressedBlock;
+		return 0;
 		unguard;
 	}
 
 	// position controller
 	virtual void Seek(int Pos)
 	{
+		DropReadWindow();
 		Position = Pos - PositionOffset;
 	}
 	virtual int Tell() const
 	{
-		return Position + PositionOffset;
+		return Position - (int)(ReadEnd - ReadPtr) + PositionOffset;
 	}
 	virtual int GetFileSize() const
 	{
@@ -233,6 +273,7 @@ public:
 	}
 	virtual void SetStopper(int Pos)
 	{
+		Position -= DropReadWindow();
 		Stopper = Pos;
 	}
 	virtual int GetStopper() const
@@ -250,6 +291,7 @@ public:
 
 	virtual void Close()
 	{
+		Position -= DropReadWindow();
 		Reader->Close();
 		if (Buffer)
 		{
@@ -257,6 +299,7 @@ public:
 			Buffer = NULL;
 			BufferStart = BufferEnd = BufferSize = 0;
 		}
+		CompressedBuffer.Free();
 		CurrentChunk = NULL;
 	}
 
@@ -233,7 +233,8 @@ static void BuildCRCTable()
 	}
 }
 
-static unsigned appStrihash(const char *str)
+// UE3 appStrihash(): case-insensitive CRC of the name in unicode form; differs from our FNV-based appStrihash()
+static unsigned StrihashUE3(const char *str)
 {
 	if (!GCRCTable[0]) BuildCRCTable();
 
@@ -341,7 +342,7 @@ static int GetRealTextureOffset_DCU(const UTexture2D *Obj)
 
 	char ObjName[256];
 	Obj->GetFullName(ARRAY_ARG(ObjName), true, true, true);
-	unsigned Hash = appStrihash(ObjName);
+	unsigned Hash = StrihashUE3(ObjName);
 	const char *TFCName = Obj->TextureFileCacheName;
 	return GetRealTextureOffset_DCU_2(Hash, TFCName);
 
@@ -393,7 +394,7 @@ void UUIStreamingTextures::PostLoad()
 		Mip->Data.BulkDataSizeOnDisk   = S.BulkDataSizeOnDisk;
 		Mip->Data.BulkDataOffsetInFile = S.BulkDataOffsetInFile;
 		// find TFC remap
-//		unsigned Hash = appStrihash("UIICONS101_I1.dds");	//??
+//		unsigned Hash = StrihashUE3("UIICONS101_I1.dds");	//??
 //		appPrintf("Hash: %08X\n", Hash);
 		if (Mip->Data.BulkDataOffsetInFile < 0)
 		{